@@ -0,0 +1,107 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/activation.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Aborts if the fast activations of Scalar stray from the exact ones by more
+// than the documented maximum error, over a dense sweep of [-10, 10].
+template <typename Scalar>
+void check_fast_accuracy(double sigmoid_error, double tanh_error) {
+  const int kPoints = 100001;
+  std::vector<Scalar> inputs(kPoints);
+  for (int i = 0; i < kPoints; i++) {
+    inputs[i] = -10 + 20.0 * i / (kPoints - 1);
+  }
+  std::vector<Scalar> sigmoids(kPoints);
+  std::vector<Scalar> tanhs(kPoints);
+  activation::sigmoid(inputs.data(), sigmoids.data(), kPoints,
+                      activation::Mode::kFast);
+  activation::tanh(inputs.data(), tanhs.data(), kPoints,
+                   activation::Mode::kFast);
+  for (int i = 0; i < kPoints; i++) {
+    double x = inputs[i];
+    if (std::abs(sigmoids[i] - activation::sigmoid(x)) > sigmoid_error ||
+        std::abs(tanhs[i] - std::tanh(x)) > tanh_error) {
+      std::fprintf(stderr, "Fast activation inaccurate at %g\n", x);
+      std::abort();
+    }
+  }
+}
+
+template <typename Scalar>
+void activate(bench::State& state, ActivationType type,
+              activation::Mode mode) {
+  std::vector<Scalar> inputs(state.arg());
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-2, 2);
+  }
+  std::vector<Scalar> outputs(state.arg());
+  while (state.keep_running()) {
+    activation::activate(type, inputs.data(), outputs.data(), inputs.size(),
+                         mode);
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Applies the scalar function to each value, as networks did per node.
+void activation_sigmoid_scalar(bench::State& state) {
+  std::vector<double> inputs(state.arg());
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-2, 2);
+  }
+  std::vector<double> outputs(state.arg());
+  while (state.keep_running()) {
+    for (size_t i = 0; i < inputs.size(); i++) {
+      outputs[i] = activation::activate(SIGMOID, inputs[i]);
+    }
+    bench::do_not_optimize(outputs);
+  }
+}
+
+void activation_sigmoid(bench::State& state) {
+  activate<double>(state, SIGMOID, activation::Mode::kExact);
+}
+
+void activation_sigmoid_fast(bench::State& state) {
+  check_fast_accuracy<double>(1.5e-7, 3e-7);
+  activate<double>(state, SIGMOID, activation::Mode::kFast);
+}
+
+void activation_sigmoid_fast_float(bench::State& state) {
+  check_fast_accuracy<float>(5e-7, 1e-6);
+  activate<float>(state, SIGMOID, activation::Mode::kFast);
+}
+
+void activation_tanh(bench::State& state) {
+  activate<double>(state, TANH, activation::Mode::kExact);
+}
+
+void activation_tanh_fast(bench::State& state) {
+  activate<double>(state, TANH, activation::Mode::kFast);
+}
+
+void activation_tanh_fast_float(bench::State& state) {
+  activate<float>(state, TANH, activation::Mode::kFast);
+}
+
+void activation_relu(bench::State& state) {
+  activate<double>(state, RELU, activation::Mode::kExact);
+}
+
+}  // namespace
+
+BENCHMARK(activation_sigmoid_scalar, 16, 256, 4096);
+BENCHMARK(activation_sigmoid, 16, 256, 4096);
+BENCHMARK(activation_sigmoid_fast, 16, 256, 4096);
+BENCHMARK(activation_sigmoid_fast_float, 16, 256, 4096);
+BENCHMARK(activation_tanh, 16, 256, 4096);
+BENCHMARK(activation_tanh_fast, 16, 256, 4096);
+BENCHMARK(activation_tanh_fast_float, 16, 256, 4096);
+BENCHMARK(activation_relu, 16, 256, 4096);
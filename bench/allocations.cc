@@ -0,0 +1,53 @@
+#include "allocations.h"
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+}  // namespace
+
+// The other forms of operator new and delete call these by default
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+// Takes precedence over the C library's, as the bench binary defines it
+extern "C" int posix_memalign(void** pointer, size_t alignment,
+                              size_t size) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+      alignment % sizeof(void*) != 0) {
+    return EINVAL;
+  }
+  void* memory = memalign(alignment, size);
+  if (memory == nullptr) {
+    return ENOMEM;
+  }
+  *pointer = memory;
+  return 0;
+}
+
+namespace bench {
+
+size_t allocation_count() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace bench
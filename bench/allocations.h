@@ -0,0 +1,15 @@
+#ifndef NEAT_LSTM_BENCH_ALLOCATIONS_H
+#define NEAT_LSTM_BENCH_ALLOCATIONS_H
+
+#include <cstddef>
+
+namespace bench {
+
+// Number of calls to the global operator new and to posix_memalign, which
+// allocates the buffers of utils::AlignedAllocator, since the start of the
+// process, over all threads. The bench binary replaces both to count them.
+size_t allocation_count();
+
+}  // namespace bench
+
+#endif
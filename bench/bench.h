@@ -0,0 +1,82 @@
+#ifndef NEAT_LSTM_BENCH_BENCH_H
+#define NEAT_LSTM_BENCH_BENCH_H
+
+#include <chrono>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// A minimal, self-contained microbenchmark harness.
+// Benchmarks are functions taking a State and looping on keep_running(); only
+// the loop itself is timed, so setup before it is excluded.
+namespace bench {
+
+class State {
+ public:
+  State(int64_t arg, size_t iterations)
+      : arg_(arg), iterations_(iterations), remaining_(iterations) {}
+
+  // Returns true while there are iterations left to run.
+  bool keep_running() {
+    if (remaining_ == iterations_) {
+      start_ = std::chrono::steady_clock::now();
+      start_cpu_ = std::clock();
+    }
+    if (remaining_ == 0) {
+      end_ = std::chrono::steady_clock::now();
+      end_cpu_ = std::clock();
+      return false;
+    }
+    remaining_--;
+    return true;
+  }
+
+  // The argument the benchmark was registered with (e.g. a genome size).
+  int64_t arg() const { return arg_; }
+
+  size_t iterations() const { return iterations_; }
+
+  // Elapsed time of the timed loop in nanoseconds.
+  double elapsed_ns() const {
+    return std::chrono::duration<double, std::nano>(end_ - start_).count();
+  }
+
+  // CPU time of the process during the timed loop in nanoseconds, including
+  // that of any worker threads.
+  double cpu_ns() const {
+    return (double)(end_cpu_ - start_cpu_) * 1e9 / CLOCKS_PER_SEC;
+  }
+
+ private:
+  int64_t arg_;
+  size_t iterations_;
+  size_t remaining_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point end_;
+  std::clock_t start_cpu_ = 0;
+  std::clock_t end_cpu_ = 0;
+};
+
+typedef void benchmark_t(State&);
+
+// Registers a benchmark to be run once per argument, or once with an argument
+// of 0 if none are given.
+bool register_benchmark(const char* name, benchmark_t* benchmark,
+                        std::initializer_list<int64_t> args);
+
+// Prevents the compiler from optimizing away the computation of value.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace bench
+
+#define BENCHMARK(benchmark, ...)                        \
+  static const bool benchmark##_registered_ =            \
+      ::bench::register_benchmark(#benchmark, benchmark, \
+                                  {__VA_ARGS__})
+
+#endif
@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/compiled_network.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/island.h"
+#include "neat_lstm/network_pool.h"
+#include "neat_lstm/thread_pool.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kConnections = 50;
+// Genomes over all islands, whatever their number
+const size_t kTotalPopulationSize = 600;
+const size_t kBatchSize = 16;
+
+// Fitness of a genome as the mean squared output on a fixed batch
+class BatchEvaluator : public Evaluator {
+ public:
+  BatchEvaluator() : batch_(kBatchSize * kInputSize) {
+    for (auto& value : batch_) {
+      value = utils::random::uniform(-1, 1);
+    }
+  }
+
+  double evaluate(const Genome& genome) override {
+    double outputs[kBatchSize * kOutputSize];
+    NetworkPool<double>::local().acquire(genome).activate_batch(
+        batch_.data(), kBatchSize, outputs);
+    double sum = 0;
+    for (double output : outputs) {
+      sum += output * output;
+    }
+    return sum / (kBatchSize * kOutputSize);
+  }
+
+ private:
+  std::vector<double> batch_;
+};
+
+IslandModel::Options options(size_t islands) {
+  IslandModel::Options options;
+  options.islands = islands;
+  options.population_size = kTotalPopulationSize / islands;
+  options.migration_interval = 2;
+  options.migrants = 2;
+  return options;
+}
+
+// Aborts unless islands evolved on a thread pool end up as those evolved on
+// the calling thread, and genome ids are unique across islands. The pool has
+// a worker per island whatever the hardware, so that islands interleave.
+void check_determinism(const Genome& seed, BatchEvaluator& evaluator) {
+  ThreadPool pool{4};
+  IslandModel::Options ring = options(4);
+  IslandModel::Options fully_connected = ring;
+  fully_connected.topology = IslandModel::Topology::kFullyConnected;
+  for (const auto& island_options : {ring, fully_connected}) {
+    IslandModel serial{seed, island_options};
+    IslandModel parallel{seed, island_options, &pool};
+    std::set<int> ids;
+    for (size_t i = 0; i < serial.size(); i++) {
+      for (const Genome* genome : serial.population(i).genomes_) {
+        ids.insert(genome->id());
+      }
+    }
+    if (ids.size() != serial.size() * island_options.population_size) {
+      std::fprintf(stderr, "IslandModel reused genome ids across islands\n");
+      std::abort();
+    }
+    for (int epoch = 0; epoch < 3; epoch++) {
+      serial.run_epoch(evaluator);
+      parallel.run_epoch(evaluator);
+    }
+    for (size_t i = 0; i < serial.size(); i++) {
+      const Population& a = serial.population(i);
+      const Population& b = parallel.population(i);
+      if (a.fitnesses_ != b.fitnesses_ ||
+          a.species_size() != b.species_size()) {
+        std::fprintf(stderr, "IslandModel mismatch on island %zu\n", i);
+        std::abort();
+      }
+      // Crossover offspring always get a new id of their island
+      for (size_t k = 0; k < a.genomes_.size(); k++) {
+        if (a.parents().at(k).second >= 0 &&
+            a.genomes_.at(k)->id() % serial.size() != i) {
+          std::fprintf(stderr, "IslandModel id %d bred on island %zu\n",
+                       a.genomes_.at(k)->id(), i);
+          std::abort();
+        }
+      }
+    }
+  }
+}
+
+// Runs an epoch of two generations over the same total population split
+// into a number of islands.
+void island_epoch(bench::State& state) {
+  Genome seed = bench::synthetic_genome(kInputSize, kOutputSize, kConnections);
+  BatchEvaluator evaluator;
+  check_determinism(seed, evaluator);
+  ThreadPool pool;
+  IslandModel model{seed, options(state.arg()), &pool};
+  while (state.keep_running()) {
+    model.run_epoch(evaluator);
+    bench::do_not_optimize(model.generation());
+  }
+}
+
+}  // namespace
+
+BENCHMARK(island_epoch, 1, 2, 4, 8);
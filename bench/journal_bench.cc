@@ -0,0 +1,124 @@
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/journal.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/journal.pb.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kConnections = 50;
+const size_t kGenerations = 8;
+const int kGenerationsPerSegment = 3;
+
+// Consecutive generations of a population, from the 1st, with random
+// fitnesses.
+std::vector<Population> generations(size_t size) {
+  std::vector<Population> populations;
+  populations.emplace_back(
+      bench::synthetic_genome(kInputSize, kOutputSize, kConnections), size);
+  while (true) {
+    for (auto& fitness : populations.back().fitnesses_) {
+      fitness = utils::random::uniform(0, 16);
+    }
+    if (populations.size() == kGenerations) {
+      return populations;
+    }
+    populations.push_back(populations.back().reproduce());
+  }
+}
+
+std::string temporary_directory() {
+  char path[] = "/tmp/neat_lstm_journal_XXXXXX";
+  if (mkdtemp(path) == nullptr) {
+    std::fprintf(stderr, "Cannot create a temporary directory\n");
+    std::abort();
+  }
+  return path;
+}
+
+void remove_directory(const std::string& directory) {
+  if (DIR* dir = opendir(directory.c_str())) {
+    while (const dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..") {
+        unlink((directory + "/" + name).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  rmdir(directory.c_str());
+}
+
+void write(const std::string& directory,
+           const std::vector<Population>& populations, size_t first) {
+  JournalWriter writer{directory, kGenerationsPerSegment};
+  for (size_t i = first; i < populations.size(); i++) {
+    writer.append(populations.at(i));
+  }
+  if (!writer.close()) {
+    std::fprintf(stderr, "%s\n", writer.error().c_str());
+    std::abort();
+  }
+}
+
+// Aborts unless a run resumed from the middle of a segment keeps the
+// generations journaled before it and replaces the later ones.
+void check_resume(std::vector<Population> populations) {
+  const std::string directory = temporary_directory();
+  write(directory, populations, 0);
+  // The resumed run evaluates the generations again, differently
+  const size_t resumed = kGenerationsPerSegment + 1;
+  for (size_t i = resumed; i < populations.size(); i++) {
+    for (auto& fitness : populations.at(i).fitnesses_) {
+      fitness += 100;
+    }
+  }
+  write(directory, populations, resumed);
+
+  JournalReader reader;
+  if (!reader.open(directory)) {
+    std::fprintf(stderr, "%s\n", reader.error().c_str());
+    std::abort();
+  }
+  std::vector<JournalRecord> records;
+  for (const Population& population : populations) {
+    bool same = reader.generation(population.generation(), &records) &&
+                records.size() == population.genomes_.size();
+    for (size_t i = 0; same && i < records.size(); i++) {
+      same = records.at(i).fitness() == population.fitnesses_.at(i) &&
+             records.at(i).genome().id() == population.genomes_.at(i)->id();
+    }
+    if (!same) {
+      std::fprintf(stderr, "Journal mismatch on generation %d after resume\n",
+                   population.generation());
+      std::abort();
+    }
+  }
+  remove_directory(directory);
+}
+
+// Journals all generations into a new journal at every iteration.
+void journal_write(bench::State& state) {
+  auto populations = generations(state.arg());
+  check_resume(populations);
+  while (state.keep_running()) {
+    const std::string directory = temporary_directory();
+    write(directory, populations, 0);
+    remove_directory(directory);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(journal_write, 50, 150, 500);
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/activation.h"
+#include "neat_lstm/lstm_kernel.h"
+#include "neat_lstm/lstm_unit_gene.h"
+#include "neat_lstm/node_gene.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const int kInputSize = 8;
+
+std::vector<double> random_inputs() {
+  std::vector<double> inputs(kInputSize);
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-1, 1);
+  }
+  return inputs;
+}
+
+// Kernels are checked against a reference implementation by
+// tests/lstm_kernel_test.cc.
+template <typename Scalar>
+void kernel_step(bench::State& state, activation::Mode mode) {
+  LSTMUnit lstm_unit = bench::synthetic_lstm_unit(state.arg(), kInputSize);
+  LSTMKernel<Scalar> kernel{lstm_unit, kInputSize, mode};
+  auto inputs = random_inputs();
+  while (state.keep_running()) {
+    std::copy(inputs.begin(), inputs.end(), kernel.inputs());
+    kernel.step();
+    bench::do_not_optimize(kernel.activations()[0]);
+  }
+}
+
+void lstm_kernel_step(bench::State& state) {
+  kernel_step<double>(state, activation::Mode::kExact);
+}
+
+void lstm_kernel_step_float(bench::State& state) {
+  kernel_step<float>(state, activation::Mode::kExact);
+}
+
+// Kernels with fast activations
+void lstm_kernel_step_fast(bench::State& state) {
+  kernel_step<double>(state, activation::Mode::kFast);
+}
+
+void lstm_kernel_step_fast_float(bench::State& state) {
+  kernel_step<float>(state, activation::Mode::kFast);
+}
+
+// Steps an LSTM unit gene, gathering its inputs from node genes.
+void lstm_unit_gene_activate(bench::State& state) {
+  LSTMUnit lstm_unit = bench::synthetic_lstm_unit(state.arg(), kInputSize);
+  std::vector<Node> nodes(kInputSize);
+  std::vector<NodeGene> node_genes;
+  for (const Node& node : nodes) {
+    node_genes.emplace_back(&node);
+    node_genes.back().activation = utils::random::uniform(-1, 1);
+  }
+  std::vector<const NodeGene*> input_node_genes;
+  for (const NodeGene& node_gene : node_genes) {
+    input_node_genes.push_back(&node_gene);
+  }
+  LSTMUnitGene gene{&lstm_unit, input_node_genes};
+  while (state.keep_running()) {
+    gene.activate();
+    bench::do_not_optimize(gene.activation(0));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(lstm_kernel_step, 8, 16, 32, 64, 128, 256, 512);
+BENCHMARK(lstm_kernel_step_float, 8, 16, 32, 64, 128, 256, 512);
+BENCHMARK(lstm_kernel_step_fast, 8, 16, 32, 64, 128, 256, 512);
+BENCHMARK(lstm_kernel_step_fast_float, 8, 16, 32, 64, 128, 256, 512);
+BENCHMARK(lstm_unit_gene_activate, 8, 16, 32, 64, 128, 256, 512);
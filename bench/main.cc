@@ -0,0 +1,147 @@
+#include <google/protobuf/text_format.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "default_config.h"
+#include "neat_lstm/config_store.h"
+#include "proto/config.pb.h"
+
+namespace bench {
+namespace {
+
+struct Benchmark {
+  std::string name;
+  benchmark_t* benchmark;
+  int64_t arg;
+};
+
+struct Result {
+  std::string name;
+  size_t iterations;
+  double real_ns;
+  double cpu_ns;
+};
+
+std::vector<Benchmark>& registry() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+// Minimum time spent in the timed loop of each benchmark
+const double kMinTimeNs = 2e8;
+
+// Prints results with the fields of Google Benchmark's JSON output that its
+// comparison tools rely on. Benchmark names need no escaping.
+void print_json(const std::vector<Result>& results) {
+  char date[32];
+  std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z",
+                std::localtime(&now));
+  std::printf("{\n");
+  std::printf("  \"context\": {\n");
+  std::printf("    \"date\": \"%s\",\n", date);
+  std::printf("    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+#ifdef NDEBUG
+  std::printf("    \"library_build_type\": \"release\"\n");
+#else
+  std::printf("    \"library_build_type\": \"debug\"\n");
+#endif
+  std::printf("  },\n");
+  std::printf("  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results.at(i);
+    std::printf("    {\n");
+    std::printf("      \"name\": \"%s\",\n", result.name.c_str());
+    std::printf("      \"run_name\": \"%s\",\n", result.name.c_str());
+    std::printf("      \"run_type\": \"iteration\",\n");
+    std::printf("      \"iterations\": %zu,\n", result.iterations);
+    std::printf("      \"real_time\": %.3f,\n", result.real_ns);
+    std::printf("      \"cpu_time\": %.3f,\n", result.cpu_ns);
+    std::printf("      \"time_unit\": \"ns\"\n");
+    std::printf("    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  std::printf("  ]\n");
+  std::printf("}\n");
+}
+
+}  // namespace
+
+bool register_benchmark(const char* name, benchmark_t* benchmark,
+                        std::initializer_list<int64_t> args) {
+  if (args.size() == 0) {
+    registry().push_back({name, benchmark, 0});
+  }
+  for (int64_t arg : args) {
+    registry().push_back({name, benchmark, arg});
+  }
+  return true;
+}
+
+}  // namespace bench
+
+// Runs all registered benchmarks, or those whose names contain the filter.
+// Results are printed as a table, or with --json in the JSON format of Google
+// Benchmark, so that results of two commits can be compared with its tools.
+// ./neat_lstm_bench [--json] [filter]
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!google::protobuf::TextFormat::ParseFromString(bench::kDefaultConfig,
+                                                     &config)) {
+    std::fprintf(stderr, "Cannot parse res/default.config\n");
+    return 1;
+  }
+  ConfigStore::get().set(config);
+
+  bool json = false;
+  const char* filter = "";
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else {
+      filter = argv[i];
+    }
+  }
+
+  std::vector<bench::Result> results;
+  for (const auto& benchmark : bench::registry()) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+
+    // Grow the iteration count until the loop runs long enough to measure
+    size_t iterations = 1;
+    double elapsed_ns = 0;
+    double cpu_ns = 0;
+    while (true) {
+      bench::State state{benchmark.arg, iterations};
+      benchmark.benchmark(state);
+      elapsed_ns = state.elapsed_ns();
+      cpu_ns = state.cpu_ns();
+      if (elapsed_ns >= bench::kMinTimeNs || iterations >= 1000000000) {
+        break;
+      }
+      double scale = elapsed_ns > 0 ? bench::kMinTimeNs / elapsed_ns : 100;
+      scale = std::min(scale * 1.2, 100.0);
+      iterations = std::max(iterations + 1, (size_t)(iterations * scale));
+    }
+
+    results.push_back({benchmark.name + "/" + std::to_string(benchmark.arg),
+                       iterations, elapsed_ns / iterations,
+                       cpu_ns / iterations});
+    if (!json) {
+      std::printf("%-40s %10lld %14.1f ns %12zu\n", benchmark.name.c_str(),
+                  (long long)benchmark.arg, elapsed_ns / iterations,
+                  iterations);
+    }
+  }
+
+  if (json) {
+    bench::print_json(results);
+  }
+}
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.h"
+#include "neat_lstm/genome_builder.h"
+#include "neat_lstm/mutation.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+
+// Structural mutations applied to each offspring by the benchmarks below, as
+// many as mutate_all() applies at most, so that building the working set is
+// not spread over more mutations than in evolution
+const int kMutations = 3;
+
+void mutate_genome(Genome& genome) {
+  for (int i = 0; i < kMutations; i++) {
+    if (i % 2 == 0) {
+      mutation::add_node(genome);
+    } else {
+      mutation::add_connection(genome);
+    }
+  }
+}
+
+void mutate_builder(Genome& genome) {
+  GenomeBuilder builder{&genome};
+  for (int i = 0; i < kMutations; i++) {
+    if (i % 2 == 0) {
+      mutation::add_node(builder);
+    } else {
+      mutation::add_connection(builder);
+    }
+  }
+}
+
+// Aborts if mutating through one builder differs from mutating the genome
+// one operation at a time with the same random stream.
+void check_builder_equivalence(const Genome& genome) {
+  Genome expected = genome;
+  Genome actual = genome;
+  {
+    utils::random::ScopedStream stream{0, 0};
+    mutate_genome(expected);
+  }
+  {
+    utils::random::ScopedStream stream{0, 0};
+    mutate_builder(actual);
+  }
+  if (expected.SerializeAsString() != actual.SerializeAsString()) {
+    std::fprintf(stderr, "GenomeBuilder mismatch on genome %d\n", genome.id());
+    std::abort();
+  }
+}
+
+// Copies a genome and applies structural mutations one at a time.
+void structural_mutations_genome(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    Genome offspring = genome;
+    mutate_genome(offspring);
+    bench::do_not_optimize(offspring);
+  }
+}
+
+// Copies a genome and applies structural mutations through one builder.
+void structural_mutations_builder(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  check_builder_equivalence(genome);
+  while (state.keep_running()) {
+    Genome offspring = genome;
+    mutate_builder(offspring);
+    bench::do_not_optimize(offspring);
+  }
+}
+
+// Copies a genome, as a baseline for the benchmarks below.
+void genome_copy(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    Genome offspring = genome;
+    bench::do_not_optimize(offspring);
+  }
+}
+
+// Copies a genome and applies all mutations with their configured
+// probabilities, as done to every offspring.
+void mutate_all(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    Genome offspring = genome;
+    mutation::mutate_all(offspring);
+    bench::do_not_optimize(offspring);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(genome_copy, 10, 100, 1000, 10000);
+BENCHMARK(mutate_all, 10, 100, 1000, 10000);
+BENCHMARK(structural_mutations_genome, 10, 100, 1000, 10000);
+BENCHMARK(structural_mutations_builder, 10, 100, 1000, 10000);
@@ -0,0 +1,364 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/activation.h"
+#include "neat_lstm/compiled_network.h"
+#include "neat_lstm/genome_delta.h"
+#include "neat_lstm/mutation.h"
+#include "neat_lstm/network.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kBatchSize = 1000;
+const size_t kSequenceLength = 32;
+
+std::vector<double> random_inputs() {
+  std::vector<double> inputs(kInputSize);
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-1, 1);
+  }
+  return inputs;
+}
+
+// Aborts if the compiled network disagrees with Network on the genome.
+void check_equivalence(const Genome& genome) {
+  Network network{genome};
+  CompiledNetwork<double> compiled{genome};
+  for (int i = 0; i < 16; i++) {
+    auto inputs = random_inputs();
+    network.activate(inputs);
+    compiled.activate(inputs);
+    if (network.activations() != compiled.activations()) {
+      std::fprintf(stderr, "CompiledNetwork mismatch on genome %d\n",
+                   genome.id());
+      std::abort();
+    }
+  }
+}
+
+// Aborts if the single precision network strays from the double precision
+// one by more than float rounding error on the genome.
+void check_float_accuracy(const Genome& genome) {
+  CompiledNetwork<double> network{genome};
+  CompiledNetwork<float> float_network{genome};
+  for (int i = 0; i < 16; i++) {
+    auto inputs = random_inputs();
+    network.activate(inputs);
+    float_network.activate(inputs);
+    auto outputs = network.activations();
+    auto float_outputs = float_network.activations();
+    for (size_t o = 0; o < outputs.size(); o++) {
+      if (std::abs(outputs[o] - float_outputs[o]) > 1e-4) {
+        std::fprintf(stderr, "Float network inaccurate on genome %d\n",
+                     genome.id());
+        std::abort();
+      }
+    }
+  }
+}
+
+std::vector<double> random_batch() {
+  std::vector<double> inputs(kBatchSize * kInputSize);
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-1, 1);
+  }
+  return inputs;
+}
+
+// Aborts if activate_batch() disagrees with activate() on the genome.
+void check_batch_equivalence(const Genome& genome) {
+  CompiledNetwork<double> network{genome};
+  auto inputs = random_batch();
+  std::vector<double> batch_outputs(kBatchSize * kOutputSize);
+  network.activate_batch(inputs.data(), kBatchSize, batch_outputs.data());
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  for (size_t b = 0; b < kBatchSize; b++) {
+    network.activate(&inputs[b * kInputSize]);
+    network.activations(&outputs[b * kOutputSize]);
+  }
+  if (outputs != batch_outputs) {
+    std::fprintf(stderr, "activate_batch mismatch on genome %d\n",
+                 genome.id());
+    std::abort();
+  }
+}
+
+void network_build(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    Network network{genome};
+    bench::do_not_optimize(network);
+  }
+}
+
+void compiled_network_build(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    CompiledNetwork<double> network{genome};
+    bench::do_not_optimize(network);
+  }
+}
+
+void network_activate(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  Network network{genome};
+  auto inputs = random_inputs();
+  while (state.keep_running()) {
+    network.activate(inputs);
+    bench::do_not_optimize(network.activations());
+  }
+}
+
+void compiled_network_activate(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  check_equivalence(genome);
+  CompiledNetwork<double> network{genome};
+  auto inputs = random_inputs();
+  std::vector<double> outputs(kOutputSize);
+  while (state.keep_running()) {
+    network.activate(inputs);
+    network.activations(outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+void compiled_network_activate_float(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  check_float_accuracy(genome);
+  CompiledNetwork<float> network{genome};
+  auto double_inputs = random_inputs();
+  std::vector<float> inputs(double_inputs.begin(), double_inputs.end());
+  std::vector<float> outputs(kOutputSize);
+  while (state.keep_running()) {
+    network.activate(inputs.data());
+    network.activations(outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Evaluates a dataset of kBatchSize samples one activate() at a time.
+void compiled_network_dataset_loop(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  CompiledNetwork<double> network{genome};
+  auto inputs = random_batch();
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  while (state.keep_running()) {
+    for (size_t b = 0; b < kBatchSize; b++) {
+      network.activate(&inputs[b * kInputSize]);
+      network.activations(&outputs[b * kOutputSize]);
+    }
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Evaluates a dataset of kBatchSize samples with one activate_batch().
+void compiled_network_dataset_batch(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  check_batch_equivalence(genome);
+  CompiledNetwork<double> network{genome};
+  auto inputs = random_batch();
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  while (state.keep_running()) {
+    network.activate_batch(inputs.data(), kBatchSize, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+void compiled_network_dataset_batch_float(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  CompiledNetwork<float> network{genome};
+  auto double_inputs = random_batch();
+  std::vector<float> inputs(double_inputs.begin(), double_inputs.end());
+  std::vector<float> outputs(kBatchSize * kOutputSize);
+  while (state.keep_running()) {
+    network.activate_batch(inputs.data(), kBatchSize, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Same as above, with fast activation functions.
+void compiled_network_dataset_batch_fast(bench::State& state) {
+  const Genome& genome =
+      bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  CompiledNetwork<double> network{genome, activation::Mode::kFast};
+  auto inputs = random_batch();
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  while (state.keep_running()) {
+    network.activate_batch(inputs.data(), kBatchSize, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Aborts if patching a network with weight-only deltas diverges from
+// recompiling the mutated genome.
+void check_update_equivalence(const Genome& genome) {
+  Genome mutated = genome;
+  CompiledNetwork<double> network{mutated};
+  GenomeDelta delta;
+  for (int i = 0; i < 8; i++) {
+    delta.clear();
+    mutation::perturb_weights(mutated, &delta);
+    if (!network.update(mutated, delta)) {
+      std::fprintf(stderr, "Weight-only delta rebuilt genome %d\n",
+                   genome.id());
+      std::abort();
+    }
+  }
+  CompiledNetwork<double> compiled{mutated};
+  auto inputs = random_inputs();
+  network.activate(inputs);
+  compiled.activate(inputs);
+  if (network.activations() != compiled.activations()) {
+    std::fprintf(stderr, "CompiledNetwork::update mismatch on genome %d\n",
+                 genome.id());
+    std::abort();
+  }
+}
+
+// Perturbs the weights of a genome and recompiles its network.
+void compiled_network_perturb_rebuild(bench::State& state) {
+  Genome genome = bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  while (state.keep_running()) {
+    mutation::perturb_weights(genome);
+    CompiledNetwork<double> network{genome};
+    bench::do_not_optimize(network);
+  }
+}
+
+// Perturbs the weights of a genome and patches its network with the delta.
+void compiled_network_perturb_update(bench::State& state) {
+  Genome genome = bench::synthetic_genome(kInputSize, kOutputSize, state.arg());
+  check_update_equivalence(genome);
+  CompiledNetwork<double> network{genome};
+  GenomeDelta delta;
+  while (state.keep_running()) {
+    delta.clear();
+    mutation::perturb_weights(genome, &delta);
+    network.update(genome, delta);
+    bench::do_not_optimize(network);
+  }
+}
+
+std::vector<float> random_sequence() {
+  std::vector<float> inputs(kSequenceLength * kInputSize);
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-1, 1);
+  }
+  return inputs;
+}
+
+// Aborts if activate_sequence() disagrees with activate() one timestep at a
+// time, or if a network does not replay a sequence exactly after a reset or
+// from a saved state.
+void check_sequence_state(const Genome& genome) {
+  const size_t half = kSequenceLength / 2;
+  const size_t output_size = kSequenceLength * kOutputSize;
+  auto inputs = random_sequence();
+
+  CompiledNetwork<float> stepped{genome};
+  std::vector<float> stepped_outputs(output_size);
+  for (size_t t = 0; t < kSequenceLength; t++) {
+    stepped.activate(&inputs[t * kInputSize]);
+    stepped.activations(&stepped_outputs[t * kOutputSize]);
+  }
+
+  CompiledNetwork<float> network{genome};
+  std::vector<float> outputs(output_size);
+  network.activate_sequence(inputs.data(), kSequenceLength, outputs.data());
+  std::vector<float> replayed(output_size);
+  network.reset_state();
+  network.activate_sequence(inputs.data(), half, replayed.data());
+  std::vector<float> state(network.state_size());
+  network.save_state(state.data());
+  network.activate_sequence(&inputs[half * kInputSize], kSequenceLength - half,
+                            &replayed[half * kOutputSize]);
+  std::vector<float> restored(outputs.begin(), outputs.end());
+  network.restore_state(state.data());
+  network.activate_sequence(&inputs[half * kInputSize], kSequenceLength - half,
+                            &restored[half * kOutputSize]);
+
+  if (outputs != stepped_outputs || outputs != replayed ||
+      outputs != restored) {
+    std::fprintf(stderr, "Sequence state mismatch on genome %d\n",
+                 genome.id());
+    std::abort();
+  }
+}
+
+// Evaluates a sequence on a new Network, which cannot be reset.
+void network_sequence_rebuild(bench::State& state) {
+  Genome genome =
+      bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100, state.arg());
+  auto sequence = random_sequence();
+  std::vector<double> inputs(kInputSize);
+  while (state.keep_running()) {
+    Network network{genome};
+    for (size_t t = 0; t < kSequenceLength; t++) {
+      inputs.assign(&sequence[t * kInputSize],
+                    &sequence[(t + 1) * kInputSize]);
+      network.activate(inputs);
+      bench::do_not_optimize(network.activations());
+    }
+  }
+}
+
+// Evaluates a sequence on a newly compiled network.
+void compiled_network_sequence_rebuild(bench::State& state) {
+  Genome genome =
+      bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100, state.arg());
+  auto inputs = random_sequence();
+  std::vector<float> outputs(kSequenceLength * kOutputSize);
+  while (state.keep_running()) {
+    CompiledNetwork<float> network{genome};
+    network.activate_sequence(inputs.data(), kSequenceLength, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Evaluates a sequence on one compiled network, reset between sequences.
+void compiled_network_sequence_reuse(bench::State& state) {
+  Genome genome =
+      bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100, state.arg());
+  check_sequence_state(genome);
+  CompiledNetwork<float> network{genome};
+  auto inputs = random_sequence();
+  std::vector<float> outputs(kSequenceLength * kOutputSize);
+  while (state.keep_running()) {
+    network.reset_state();
+    network.activate_sequence(inputs.data(), kSequenceLength, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(network_build, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_build, 10, 100, 1000, 10000);
+BENCHMARK(network_activate, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_activate, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_activate_float, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_dataset_loop, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_dataset_batch, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_dataset_batch_float, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_dataset_batch_fast, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_perturb_rebuild, 10, 100, 1000, 10000);
+BENCHMARK(compiled_network_perturb_update, 10, 100, 1000, 10000);
+BENCHMARK(network_sequence_rebuild, 8, 32, 128);
+BENCHMARK(compiled_network_sequence_rebuild, 8, 32, 128);
+BENCHMARK(compiled_network_sequence_reuse, 8, 32, 128);
@@ -0,0 +1,224 @@
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "allocations.h"
+#include "bench.h"
+#include "neat_lstm/compiled_network.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/network_pool.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kPopulationSize = 16;
+// Samples per genome, few as in XOR, so that building networks dominates
+const size_t kBatchSize = 4;
+const size_t kSequenceLength = 8;
+// Population evaluated with evaluate(), and the workers evaluating it
+const size_t kEvaluatedPopulationSize = 300;
+const size_t kThreads = 4;
+
+// Genomes of about the number of connections, all of different sizes so that
+// every rebuild changes the shape of the buffers.
+std::vector<const Genome*> population(size_t connections) {
+  std::vector<const Genome*> genomes;
+  for (size_t i = 0; i < kPopulationSize; i++) {
+    genomes.push_back(
+        &bench::synthetic_genome(kInputSize, kOutputSize, connections + i));
+  }
+  return genomes;
+}
+
+std::vector<double> random_matrix(size_t rows) {
+  std::vector<double> values(rows * kInputSize);
+  for (auto& value : values) {
+    value = utils::random::uniform(-1, 1);
+  }
+  return values;
+}
+
+// Evaluates every genome on the batch with networks of the pool, then aborts
+// if the outputs differ from those of fresh networks or if a second pass
+// allocates. LSTM genomes of varying capacities are evaluated on a sequence
+// in between, so that the pool also moves kernels to and from its spares.
+void check_steady_state(const std::vector<const Genome*>& genomes) {
+  std::vector<Genome> lstm_genomes;
+  for (int capacity : {4, 8, 2}) {
+    lstm_genomes.push_back(bench::synthetic_lstm_genome(
+        kInputSize, kOutputSize, genomes.front()->connections_size(),
+        capacity));
+  }
+  auto batch = random_matrix(kBatchSize);
+  auto sequence = random_matrix(kSequenceLength);
+  std::vector<double> outputs(kSequenceLength * kOutputSize);
+  std::vector<double> expected(outputs.size());
+
+  auto& pool = NetworkPool<double>::local();
+  auto pass = [&](bool check) {
+    for (size_t i = 0; i < genomes.size(); i++) {
+      const Genome& genome = *genomes[i];
+      pool.acquire(genome).activate_batch(batch.data(), kBatchSize,
+                                          outputs.data());
+      if (check) {
+        CompiledNetwork<double>{genome}.activate_batch(
+            batch.data(), kBatchSize, expected.data());
+      }
+      const Genome& lstm_genome = lstm_genomes[i % lstm_genomes.size()];
+      pool.acquire(lstm_genome).activate_sequence(
+          sequence.data(), kSequenceLength, outputs.data());
+      if (check) {
+        CompiledNetwork<double>{lstm_genome}.activate_sequence(
+            sequence.data(), kSequenceLength, expected.data());
+      }
+      if (check && outputs != expected) {
+        std::fprintf(stderr, "NetworkPool mismatch on genome %d\n",
+                     genome.id());
+        std::abort();
+      }
+    }
+  };
+  pass(true);
+  size_t allocations = bench::allocation_count();
+  pass(false);
+  allocations = bench::allocation_count() - allocations;
+  if (allocations != 0) {
+    std::fprintf(stderr, "NetworkPool allocated %zu times in steady state\n",
+                 allocations);
+    std::abort();
+  }
+}
+
+// Fitness of a genome as the mean output over a fixed sequence, computed with
+// the network pool of the evaluating thread.
+class SequenceEvaluator : public Evaluator {
+ public:
+  SequenceEvaluator() : sequence_(random_matrix(kSequenceLength)) {}
+
+  double evaluate(const Genome& genome) override {
+    double outputs[kSequenceLength * kOutputSize];
+    NetworkPool<double>::local().acquire(genome).activate_sequence(
+        sequence_.data(), kSequenceLength, outputs);
+    double sum = 0;
+    for (double output : outputs) {
+      sum += output;
+    }
+    return sum / (kSequenceLength * kOutputSize);
+  }
+
+  size_t sequence_length() const override { return kSequenceLength; }
+
+ private:
+  std::vector<double> sequence_;
+};
+
+// A population grown from the first genome, in which the others and LSTM
+// genomes of varying capacities replace some of the offspring.
+Population mixed_population(const std::vector<const Genome*>& genomes) {
+  Population population{*genomes.front(), kEvaluatedPopulationSize};
+  size_t index = 0;
+  for (const Genome* genome : genomes) {
+    population.replace(index++, *genome, 0);
+  }
+  for (int capacity : {4, 8, 2}) {
+    population.replace(index++,
+                       bench::synthetic_lstm_genome(
+                           kInputSize, kOutputSize,
+                           genomes.front()->connections_size(), capacity),
+                       0);
+  }
+  return population;
+}
+
+// Has every worker of the pool acquire a network for each genome, so that the
+// network pools of all workers have grown to the population whichever genomes
+// they are dealt later. Tasks wait for each other, so each worker runs one.
+void warm_up(ThreadPool& pool, const Population& population) {
+  std::mutex mutex;
+  std::condition_variable arrived;
+  size_t waiting = 0;
+  pool.parallel_for(pool.size(), [&](size_t, size_t /*worker*/) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      waiting++;
+      arrived.notify_all();
+      arrived.wait(lock, [&] { return waiting == pool.size(); });
+    }
+    for (const Genome* genome : population.genomes_) {
+      NetworkPool<double>::local().acquire(*genome);
+    }
+  });
+}
+
+// Aborts if evaluating the population on the pool a second time allocates,
+// including aligned buffers of LSTM kernels.
+void check_evaluation_steady_state(Population& population,
+                                   Evaluator& evaluator, ThreadPool& pool) {
+  warm_up(pool, population);
+  evaluate(population, evaluator, pool);
+  size_t allocations = bench::allocation_count();
+  evaluate(population, evaluator, pool);
+  allocations = bench::allocation_count() - allocations;
+  if (allocations != 0) {
+    std::fprintf(stderr, "evaluate() allocated %zu times in steady state\n",
+                 allocations);
+    std::abort();
+  }
+}
+
+// Builds a network for each genome of the population, as the main loop did.
+void population_evaluate_fresh(bench::State& state) {
+  auto genomes = population(state.arg());
+  auto batch = random_matrix(kBatchSize);
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  while (state.keep_running()) {
+    for (const Genome* genome : genomes) {
+      CompiledNetwork<double> network{*genome};
+      network.activate_batch(batch.data(), kBatchSize, outputs.data());
+      bench::do_not_optimize(outputs);
+    }
+  }
+}
+
+void population_evaluate_pooled(bench::State& state) {
+  auto genomes = population(state.arg());
+  check_steady_state(genomes);
+  auto batch = random_matrix(kBatchSize);
+  std::vector<double> outputs(kBatchSize * kOutputSize);
+  auto& pool = NetworkPool<double>::local();
+  while (state.keep_running()) {
+    for (const Genome* genome : genomes) {
+      pool.acquire(*genome).activate_batch(batch.data(), kBatchSize,
+                                           outputs.data());
+      bench::do_not_optimize(outputs);
+    }
+  }
+}
+
+// Evaluates the population with evaluate() on a thread pool, as the main loop
+// does.
+void population_evaluate_threaded(bench::State& state) {
+  auto genomes = population(state.arg());
+  Population mixed = mixed_population(genomes);
+  SequenceEvaluator evaluator;
+  ThreadPool pool{kThreads};
+  check_evaluation_steady_state(mixed, evaluator, pool);
+  while (state.keep_running()) {
+    evaluate(mixed, evaluator, pool);
+    bench::do_not_optimize(mixed.fitnesses_);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(population_evaluate_fresh, 10, 100, 1000);
+BENCHMARK(population_evaluate_pooled, 10, 100, 1000);
+BENCHMARK(population_evaluate_threaded, 10, 100, 1000);
@@ -0,0 +1,116 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "neat_lstm/utils/genome_utils.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kPopulationSize = 150;
+// Population bred by check_thread_independence()
+const size_t kBredPopulationSize = 600;
+const int kBredGenerations = 15;
+
+// Creates a population of mutations of a synthetic genome, with random
+// fitnesses.
+Population synthetic_population(size_t connections) {
+  Population population{
+      bench::synthetic_genome(kInputSize, kOutputSize, connections),
+      kPopulationSize};
+  population.fitnesses_.resize(population.genomes_.size());
+  for (auto& fitness : population.fitnesses_) {
+    fitness = utils::random::uniform(0, 16);
+  }
+  return population;
+}
+
+// Fitness of each genome as the sum of its absolute weights, so that it only
+// depends on the genome.
+void weight_fitnesses(Population& population) {
+  population.fitnesses_.resize(population.genomes_.size());
+  for (size_t i = 0; i < population.genomes_.size(); i++) {
+    double fitness = 0;
+    for (const auto& connection : population.genomes_.at(i)->connections()) {
+      fitness += std::abs(connection.weight());
+    }
+    population.fitnesses_.at(i) = fitness;
+  }
+}
+
+// Breeds generations from the seed on a pool of the number of threads, and
+// returns a hash of the serialized genomes of the last one. Every call starts
+// from the same genome ids and from a fresh innovation registry.
+size_t bred_hash(const Genome& seed, size_t threads) {
+  InnovationRegistry registry;
+  ScopedRegistry scope{registry};
+  Genome numbered = seed;
+  registry.adopt(numbered);
+  registry.commit();
+  registry.renumber(numbered);
+  const int genome_id = utils::genome_id;
+  utils::genome_id = 0;
+
+  ThreadPool pool{threads};
+  Population population{numbered, kBredPopulationSize, &pool};
+  weight_fitnesses(population);
+  for (int g = 1; g < kBredGenerations; g++) {
+    population = population.reproduce();
+    weight_fitnesses(population);
+  }
+  std::string bytes;
+  for (const Genome* genome : population.genomes_) {
+    genome->AppendToString(&bytes);
+  }
+  utils::genome_id = genome_id;
+  return std::hash<std::string>()(bytes);
+}
+
+// Aborts unless breeding on several threads gives the same genomes as on one.
+// The pools have more workers than the hardware may have threads, so that
+// breeding interleaves.
+void check_thread_independence() {
+  const Genome& seed = bench::synthetic_genome(kInputSize, kOutputSize, 10);
+  const size_t expected = bred_hash(seed, 1);
+  for (size_t threads : {1, 2, 4, 8, 8}) {
+    if (bred_hash(seed, threads) != expected) {
+      std::fprintf(stderr, "Population bred on %zu threads differs\n",
+                   threads);
+      std::abort();
+    }
+  }
+}
+
+void population_speciate(bench::State& state) {
+  Population population = synthetic_population(state.arg());
+  while (state.keep_running()) {
+    population.speciate();
+    bench::do_not_optimize(population.species_size());
+  }
+}
+
+// Breeds the next generation from the same population at every iteration.
+void population_reproduce(bench::State& state) {
+  check_thread_independence();
+  Population population = synthetic_population(state.arg());
+  while (state.keep_running()) {
+    Population offspring = population.reproduce();
+    bench::do_not_optimize(offspring.species_size());
+  }
+}
+
+}  // namespace
+
+BENCHMARK(population_speciate, 10, 100, 1000, 10000);
+BENCHMARK(population_reproduce, 10, 100, 1000, 10000);
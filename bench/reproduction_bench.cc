@@ -0,0 +1,33 @@
+#include "bench.h"
+#include "neat_lstm/reproduction.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+// Crossover is checked against the original implementation by
+// tests/crossover_test.cc.
+void crossover_fresh_child(bench::State& state) {
+  bench::GenomePair pair{(size_t)state.arg()};
+  while (state.keep_running()) {
+    Genome child;
+    reproduction::crossover(pair.a, pair.b, &child);
+    bench::do_not_optimize(child);
+  }
+}
+
+// Crosses over into a cleared child, whose connections are reused.
+void crossover_reused_child(bench::State& state) {
+  bench::GenomePair pair{(size_t)state.arg()};
+  Genome child;
+  while (state.keep_running()) {
+    child.Clear();
+    reproduction::crossover(pair.a, pair.b, &child);
+    bench::do_not_optimize(child);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(crossover_fresh_child, 10, 100, 1000, 10000);
+BENCHMARK(crossover_reused_child, 10, 100, 1000, 10000);
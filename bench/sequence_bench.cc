@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/compiled_network.h"
+#include "neat_lstm/sequence_trie.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+
+// Scenarios share a history of kHistoryLength timesteps, then branch
+// kBranching ways at each of the last kScenarioLength timesteps.
+const size_t kHistoryLength = 48;
+const size_t kScenarioLength = 4;
+const size_t kBranching = 4;
+
+// A dataset of kBranching^kScenarioLength scenarios, as row-major matrices
+std::vector<std::vector<float>> scenarios() {
+  auto random_step = [](std::vector<float>* sequence) {
+    for (size_t i = 0; i < kInputSize; i++) {
+      sequence->push_back(utils::random::uniform(-1, 1));
+    }
+  };
+  std::vector<float> history;
+  for (size_t t = 0; t < kHistoryLength; t++) {
+    random_step(&history);
+  }
+
+  // Branches at each level, which all scenarios choose from
+  std::vector<std::vector<float>> branches(kScenarioLength * kBranching);
+  for (auto& branch : branches) {
+    random_step(&branch);
+  }
+  std::vector<std::vector<float>> scenarios{history};
+  for (size_t t = 0; t < kScenarioLength; t++) {
+    std::vector<std::vector<float>> next;
+    for (const auto& scenario : scenarios) {
+      for (size_t b = 0; b < kBranching; b++) {
+        next.push_back(scenario);
+        const auto& branch = branches[t * kBranching + b];
+        next.back().insert(next.back().end(), branch.begin(), branch.end());
+      }
+    }
+    scenarios.swap(next);
+  }
+  return scenarios;
+}
+
+SequenceTrie<float> scenario_trie(
+    const std::vector<std::vector<float>>& sequences) {
+  SequenceTrie<float> trie{kInputSize};
+  for (const auto& sequence : sequences) {
+    trie.add(sequence.data(), sequence.size() / kInputSize);
+  }
+  return trie;
+}
+
+// Evaluates each sequence from a reset state.
+void replay(CompiledNetwork<float>& network,
+            const std::vector<std::vector<float>>& sequences,
+            float* outputs) {
+  for (const auto& sequence : sequences) {
+    size_t length = sequence.size() / kInputSize;
+    network.reset_state();
+    network.activate_sequence(sequence.data(), length, outputs);
+    outputs += length * kOutputSize;
+  }
+}
+
+// Aborts if evaluating the trie disagrees with replaying every sequence, with
+// room for any number of saved states, for two, or for none.
+void check_trie_equivalence(const Genome& genome) {
+  auto sequences = scenarios();
+  auto trie = scenario_trie(sequences);
+  CompiledNetwork<float> network{genome};
+  std::vector<float> expected(trie.total_length() * kOutputSize);
+  replay(network, sequences, expected.data());
+
+  const size_t state_bytes = network.state_size() * sizeof(float);
+  for (size_t memory_cap : {SequenceTrie<float>::kDefaultMemoryCap,
+                            2 * state_bytes, (size_t)0}) {
+    std::vector<float> outputs(expected.size());
+    trie.evaluate(network, outputs.data(), memory_cap);
+    if (outputs != expected) {
+      std::fprintf(stderr, "SequenceTrie mismatch with a cap of %zu bytes\n",
+                   memory_cap);
+      std::abort();
+    }
+  }
+}
+
+void sequence_replay(bench::State& state) {
+  Genome genome = bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100,
+                                               state.arg());
+  CompiledNetwork<float> network{genome};
+  auto sequences = scenarios();
+  std::vector<float> outputs(sequences.size() *
+                             (kHistoryLength + kScenarioLength) * kOutputSize);
+  while (state.keep_running()) {
+    replay(network, sequences, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+void sequence_trie(bench::State& state) {
+  Genome genome = bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100,
+                                               state.arg());
+  check_trie_equivalence(genome);
+  CompiledNetwork<float> network{genome};
+  auto trie = scenario_trie(scenarios());
+  std::vector<float> outputs(trie.total_length() * kOutputSize);
+  while (state.keep_running()) {
+    trie.evaluate(network, outputs.data());
+    bench::do_not_optimize(outputs);
+  }
+}
+
+// Evaluates the trie with room for two saved states, so that the states of
+// most branch points are evicted and replayed.
+void sequence_trie_capped(bench::State& state) {
+  Genome genome = bench::synthetic_lstm_genome(kInputSize, kOutputSize, 100,
+                                               state.arg());
+  CompiledNetwork<float> network{genome};
+  auto trie = scenario_trie(scenarios());
+  std::vector<float> outputs(trie.total_length() * kOutputSize);
+  const size_t memory_cap = 2 * network.state_size() * sizeof(float);
+  while (state.keep_running()) {
+    trie.evaluate(network, outputs.data(), memory_cap);
+    bench::do_not_optimize(outputs);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(sequence_replay, 8, 32);
+BENCHMARK(sequence_trie, 8, 32);
+BENCHMARK(sequence_trie_capped, 8, 32);
@@ -0,0 +1,40 @@
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/config_store.h"
+#include "neat_lstm/utils/genome_utils.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+void compatibility(bench::State& state) {
+  bench::GenomePair pair{(size_t)state.arg()};
+  while (state.keep_running()) {
+    bench::do_not_optimize(utils::compatibility(pair.a, pair.b));
+  }
+}
+
+void compatible_bounded(bench::State& state) {
+  bench::GenomePair pair{(size_t)state.arg()};
+  double threshold = ConfigStore::speciation().compatibility_threshold();
+  while (state.keep_running()) {
+    bench::do_not_optimize(utils::compatible(pair.a, pair.b, threshold));
+  }
+}
+
+void compatible_flat(bench::State& state) {
+  bench::GenomePair pair{(size_t)state.arg()};
+  utils::FlatConnections a{pair.a};
+  utils::FlatConnections b{pair.b};
+  double threshold = ConfigStore::speciation().compatibility_threshold();
+  while (state.keep_running()) {
+    bench::do_not_optimize(utils::compatible(a, b, threshold));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(compatibility, 10, 100, 1000, 10000);
+BENCHMARK(compatible_bounded, 10, 100, 1000, 10000);
+BENCHMARK(compatible_flat, 10, 100, 1000, 10000);
@@ -0,0 +1,100 @@
+#include "synthetic.h"
+
+#include <cmath>
+#include <initializer_list>
+#include <map>
+#include <tuple>
+
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/mutation.h"
+#include "neat_lstm/utils/genome_utils.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+
+namespace bench {
+
+namespace {
+
+// Gives the connections first seen in the genomes final innovation numbers,
+// as done at the end of every generation, so that the genomes remain valid
+// after later commits.
+void commit_innovations(std::initializer_list<Genome*> genomes) {
+  InnovationRegistry& registry = Innovation::registry();
+  registry.commit();
+  for (Genome* genome : genomes) {
+    registry.renumber(*genome);
+  }
+}
+
+}  // namespace
+
+const Genome& synthetic_genome(size_t input_size, size_t output_size,
+                               size_t connections) {
+  static std::map<std::tuple<size_t, size_t, size_t>, Genome> cache;
+  auto key = std::make_tuple(input_size, output_size, connections);
+  if (cache.find(key) != cache.end()) {
+    return cache.at(key);
+  }
+
+  Genome& genome = cache[key];
+  genome = utils::create_genome(input_size, output_size);
+
+  // Grow hidden nodes and connections at roughly a 1:4 ratio. add_connection()
+  // is a no-op for existing connections, so bound the number of attempts.
+  size_t attempts = 0;
+  while ((size_t)genome.connections_size() < connections &&
+         attempts++ < 16 * connections) {
+    if (utils::random::uniform(0, 1) < 0.2) {
+      mutation::add_node(genome);
+    } else {
+      mutation::add_connection(genome);
+    }
+  }
+  commit_innovations({&genome});
+
+  return genome;
+}
+
+LSTMUnit synthetic_lstm_unit(int capacity, int input_size) {
+  LSTMUnit lstm_unit;
+  lstm_unit.set_capacity(capacity);
+  int size = capacity * (capacity + input_size);
+  // Scale weights down with size to keep the gates out of saturation
+  double bound = 1.0 / std::sqrt(capacity + input_size);
+  for (int i = 0; i < size; i++) {
+    lstm_unit.add_input_weights(utils::random::uniform(-bound, bound));
+    lstm_unit.add_forget_weights(utils::random::uniform(-bound, bound));
+    lstm_unit.add_state_weights(utils::random::uniform(-bound, bound));
+    lstm_unit.add_output_weights(utils::random::uniform(-bound, bound));
+  }
+  lstm_unit.set_input_bias(utils::random::uniform(-1, 1));
+  lstm_unit.set_forget_bias(utils::random::uniform(-1, 1));
+  lstm_unit.set_state_bias(utils::random::uniform(-1, 1));
+  lstm_unit.set_output_bias(utils::random::uniform(-1, 1));
+  return lstm_unit;
+}
+
+Genome synthetic_lstm_genome(size_t input_size, size_t output_size,
+                             size_t connections, int capacity) {
+  Genome genome = synthetic_genome(input_size, output_size, connections);
+  LSTMUnit* lstm_unit = genome.add_lstm_units();
+  *lstm_unit = synthetic_lstm_unit(capacity, input_size);
+  for (const Node& node : genome.nodes()) {
+    if (node.type() == Node::HIDDEN &&
+        lstm_unit->out_nodes_size() < capacity) {
+      lstm_unit->add_out_nodes(node.id());
+    }
+  }
+  return genome;
+}
+
+GenomePair::GenomePair(size_t connections)
+    : a(synthetic_genome(8, 4, connections)), b(a) {
+  for (size_t i = 0; i < connections / 10 + 1; i++) {
+    mutation::add_connection(a);
+    mutation::add_node(b);
+  }
+  commit_innovations({&a, &b});
+}
+
+}  // namespace bench
@@ -0,0 +1,35 @@
+#ifndef NEAT_LSTM_BENCH_SYNTHETIC_H
+#define NEAT_LSTM_BENCH_SYNTHETIC_H
+
+#include <cstddef>
+
+#include "proto/structures.pb.h"
+
+namespace bench {
+
+// Creates a genome with roughly the specified number of connections by
+// repeatedly applying structural mutations to a basic genome. Genomes are
+// cached by their parameters, since growing large genomes is slow.
+const Genome& synthetic_genome(size_t input_size, size_t output_size,
+                        size_t connections);
+
+// Creates an LSTM unit with random weights, scaled down with size to keep the
+// gates out of saturation.
+LSTMUnit synthetic_lstm_unit(int capacity, int input_size);
+
+// Adds an LSTM unit of the capacity to a synthetic genome, feeding its first
+// hidden nodes.
+Genome synthetic_lstm_genome(size_t input_size, size_t output_size,
+                             size_t connections, int capacity);
+
+// A pair of genomes sharing an ancestor, diverged by structural mutations
+struct GenomePair {
+  Genome a;
+  Genome b;
+
+  explicit GenomePair(size_t connections);
+};
+
+}  // namespace bench
+
+#endif
@@ -0,0 +1,27 @@
+#include "bench.h"
+#include "neat_lstm/trace.h"
+
+namespace {
+
+void trace_span_disabled(bench::State& state) {
+  trace::stop();
+  while (state.keep_running()) {
+    trace::ScopedSpan span{"bench", 0};
+    bench::do_not_optimize(span);
+  }
+}
+
+// Records spans into a ring buffer small enough to wrap around many times.
+void trace_span_enabled(bench::State& state) {
+  trace::start(1 << 10);
+  while (state.keep_running()) {
+    trace::ScopedSpan span{"bench", 0};
+    bench::do_not_optimize(span);
+  }
+  trace::stop();
+}
+
+}  // namespace
+
+BENCHMARK(trace_span_disabled);
+BENCHMARK(trace_span_enabled);
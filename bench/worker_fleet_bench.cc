@@ -0,0 +1,207 @@
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "neat_lstm/compiled_network.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/network_pool.h"
+#include "neat_lstm/utils/random.h"
+#include "neat_lstm/utils/record_io.h"
+#include "neat_lstm/worker_fleet.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+
+namespace {
+
+const size_t kInputSize = 8;
+const size_t kOutputSize = 4;
+const size_t kPopulationSize = 64;
+const size_t kWorkers = 2;
+// Rows of the dataset each genome is evaluated on
+const size_t kDatasetSize = 256;
+
+// Writes a random dataset of kDatasetSize rows to a temporary file and maps
+// it, so that the workers share the coordinator's pages.
+utils::MappedFile dataset() {
+  char path[] = "/tmp/neat_lstm_bench_XXXXXX";
+  int fd = mkstemp(path);
+  std::vector<double> rows(kDatasetSize * kInputSize);
+  for (auto& value : rows) {
+    value = utils::random::uniform(-1, 1);
+  }
+  size_t bytes = rows.size() * sizeof(double);
+  if (fd < 0 || write(fd, rows.data(), bytes) != (ssize_t)bytes) {
+    std::fprintf(stderr, "Cannot write dataset to %s\n", path);
+    std::abort();
+  }
+  close(fd);
+  utils::MappedFile file;
+  std::string error;
+  if (!file.open(path, &error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    std::abort();
+  }
+  unlink(path);
+  return file;
+}
+
+// Fitness of a genome as the mean squared output on the mapped dataset
+class DatasetEvaluator : public Evaluator {
+ public:
+  explicit DatasetEvaluator(const utils::MappedFile& dataset)
+      : dataset_(dataset), outputs_(kDatasetSize * kOutputSize) {}
+
+  double evaluate(const Genome& genome) override {
+    NetworkPool<double>::local().acquire(genome).activate_batch(
+        reinterpret_cast<const double*>(dataset_.data()), kDatasetSize,
+        outputs_.data());
+    double sum = 0;
+    for (double output : outputs_) {
+      sum += output * output;
+    }
+    return sum / outputs_.size();
+  }
+
+ private:
+  const utils::MappedFile& dataset_;
+  std::vector<double> outputs_;
+};
+
+// Kills its process on every genome in poison_ids, and on every genome after
+// the first crash_interval ones a process evaluates, so that each worker
+// eventually dies while healthy genomes are pending.
+class CrashingEvaluator : public DatasetEvaluator {
+ public:
+  CrashingEvaluator(const utils::MappedFile& dataset,
+                    std::vector<int> poison_ids, int crash_interval)
+      : DatasetEvaluator(dataset),
+        poison_ids_(poison_ids),
+        crash_interval_(crash_interval) {}
+
+  double evaluate(const Genome& genome) override {
+    for (int id : poison_ids_) {
+      if (genome.id() == id) {
+        _exit(1);
+      }
+    }
+    if (++evaluated_ > crash_interval_) {
+      _exit(1);
+    }
+    return DatasetEvaluator::evaluate(genome);
+  }
+
+ private:
+  std::vector<int> poison_ids_;
+  int crash_interval_;
+  int evaluated_ = 0;
+};
+
+// Distinct genomes of varied sizes
+std::vector<Genome> population() {
+  std::vector<Genome> genomes;
+  for (size_t i = 0; i < kPopulationSize; i++) {
+    genomes.push_back(
+        bench::synthetic_genome(kInputSize, kOutputSize, 50 + i % 8 * 25));
+    genomes.back().set_id(i);
+  }
+  return genomes;
+}
+
+std::vector<Genome*> pointers(std::vector<Genome>& genomes) {
+  std::vector<Genome*> pointers;
+  for (auto& genome : genomes) {
+    pointers.push_back(&genome);
+  }
+  return pointers;
+}
+
+// Aborts unless workers that crash on some genomes give the same fitnesses as
+// evaluating in process, with failure_fitness for the poisoned genomes, after
+// replacing the crashed workers.
+void check_crash_recovery(const utils::MappedFile& file) {
+  auto genomes = population();
+  const std::vector<int> poison_ids = {5, 40};
+  DatasetEvaluator evaluator{file};
+  CrashingEvaluator crashing{file, poison_ids, 20};
+
+  WorkerFleet::Options options;
+  options.workers = kWorkers;
+  options.batch_size = 4;
+  options.failure_fitness = -1;
+  WorkerFleet fleet{crashing, options};
+  std::vector<double> fitnesses;
+  if (!fleet.start() || !fleet.evaluate(pointers(genomes), &fitnesses)) {
+    std::fprintf(stderr, "%s\n", fleet.error().c_str());
+    std::abort();
+  }
+  for (size_t i = 0; i < genomes.size(); i++) {
+    bool poisoned = genomes[i].id() == poison_ids[0] ||
+                    genomes[i].id() == poison_ids[1];
+    double expected = poisoned ? -1 : evaluator.evaluate(genomes[i]);
+    if (fitnesses[i] != expected) {
+      std::fprintf(stderr, "WorkerFleet mismatch on genome %d\n",
+                   genomes[i].id());
+      std::abort();
+    }
+  }
+  if (fleet.restarts() == 0) {
+    std::fprintf(stderr, "WorkerFleet did not restart crashed workers\n");
+    std::abort();
+  }
+}
+
+void fleet_evaluate(bench::State& state, size_t pipeline_depth) {
+  auto file = dataset();
+  check_crash_recovery(file);
+  auto genomes = population();
+  auto genome_pointers = pointers(genomes);
+  DatasetEvaluator evaluator{file};
+  WorkerFleet::Options options;
+  options.workers = kWorkers;
+  options.batch_size = state.arg();
+  options.pipeline_depth = pipeline_depth;
+  WorkerFleet fleet{evaluator, options};
+  if (!fleet.start()) {
+    std::fprintf(stderr, "%s\n", fleet.error().c_str());
+    std::abort();
+  }
+  std::vector<double> fitnesses;
+  while (state.keep_running()) {
+    fleet.evaluate(genome_pointers, &fitnesses);
+    bench::do_not_optimize(fitnesses);
+  }
+}
+
+// Evaluates the population in the benchmark's process, as a baseline for the
+// overhead of workers.
+void fleet_evaluate_in_process(bench::State& state) {
+  auto file = dataset();
+  auto genomes = population();
+  DatasetEvaluator evaluator{file};
+  std::vector<double> fitnesses(genomes.size());
+  while (state.keep_running()) {
+    for (size_t i = 0; i < genomes.size(); i++) {
+      fitnesses[i] = evaluator.evaluate(genomes[i]);
+    }
+    bench::do_not_optimize(fitnesses);
+  }
+}
+
+void fleet_evaluate_pipelined(bench::State& state) {
+  fleet_evaluate(state, 2);
+}
+
+// A single batch in flight per worker, which then idles while the coordinator
+// receives its results and sends the next batch.
+void fleet_evaluate_unpipelined(bench::State& state) {
+  fleet_evaluate(state, 1);
+}
+
+}  // namespace
+
+BENCHMARK(fleet_evaluate_in_process);
+BENCHMARK(fleet_evaluate_pipelined, 1, 4, 16);
+BENCHMARK(fleet_evaluate_unpipelined, 1, 4, 16);
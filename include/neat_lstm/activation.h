@@ -1,19 +1,65 @@
 #ifndef NEAT_LSTM_ACTIVATION_H
 #define NEAT_LSTM_ACTIVATION_H
 
-#include <unordered_map>
+#include <cstddef>
 
 #include "proto/structures.pb.h"
 
-typedef double activation_t(double);
+template <typename Scalar>
+using activation_t = Scalar(Scalar);
 
+// Activation functions, instantiated for float and double. Each function comes
+// as a scalar version and as a kernel over arrays. The relu kernel and those
+// of Mode::kFast are vectorized with AVX-512, AVX2 or SSE2, whichever the
+// build targets; those of Mode::kExact are scalar loops, so that they match
+// the scalar functions bit for bit.
 namespace activation {
 
-double sigmoid(double x);
-double tanh(double x);
-double relu(double x);
+// Accuracy of the activation functions
+enum class Mode {
+  // Computed with the standard library, exactly as the scalar functions
+  kExact,
+  // A rational approximation of tanh, which sigmoid is derived from as
+  // sigmoid(x) = (1 + tanh(2.45x)) / 2. The maximum absolute error is 3e-7 for
+  // tanh and 1.5e-7 for sigmoid in double precision, plus rounding error in
+  // single precision (1e-6 and 5e-7 in total). Relu is always exact.
+  kFast,
+};
 
-const std::unordered_map<ActivationType, activation_t*>& get_activation_map();
+template <typename Scalar>
+Scalar sigmoid(Scalar x);
+template <typename Scalar>
+Scalar tanh(Scalar x);
+template <typename Scalar>
+Scalar relu(Scalar x);
+
+// Fast approximations, see Mode::kFast.
+template <typename Scalar>
+Scalar fast_sigmoid(Scalar x);
+template <typename Scalar>
+Scalar fast_tanh(Scalar x);
+
+// Apply the function to size values of inputs, writing them to outputs. The
+// arrays may be the same.
+template <typename Scalar>
+void sigmoid(const Scalar* inputs, Scalar* outputs, size_t size,
+             Mode mode = Mode::kExact);
+template <typename Scalar>
+void tanh(const Scalar* inputs, Scalar* outputs, size_t size,
+          Mode mode = Mode::kExact);
+template <typename Scalar>
+void relu(const Scalar* inputs, Scalar* outputs, size_t size);
+
+// Returns true if the activation type has a function.
+bool is_defined(ActivationType type);
+
+// Applies the function of the activation type, which must be defined.
+template <typename Scalar>
+Scalar activate(ActivationType type, Scalar x, Mode mode = Mode::kExact);
+// Same as above, over size values of inputs.
+template <typename Scalar>
+void activate(ActivationType type, const Scalar* inputs, Scalar* outputs,
+              size_t size, Mode mode = Mode::kExact);
 
 }  // namespace activation
 
@@ -0,0 +1,48 @@
+#ifndef NEAT_LSTM_BACKGROUND_WRITER_H
+#define NEAT_LSTM_BACKGROUND_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs write tasks one at a time, in the order they were submitted, on a
+// dedicated thread, so that serialization and I/O overlap with evolution.
+class BackgroundWriter {
+ public:
+  // Returns an error message, or an empty string on success.
+  typedef std::function<std::string()> Task;
+
+  BackgroundWriter();
+
+  // Runs the queued tasks, then stops the thread.
+  ~BackgroundWriter();
+
+  void submit(Task task);
+
+  // Blocks until all submitted tasks have run. Returns false if any failed
+  // since the last call, with the reason of the last failure in error().
+  bool flush();
+
+  const std::string& error() const;
+
+  BackgroundWriter(const BackgroundWriter&) = delete;
+  BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable done_;
+  std::deque<Task> tasks_;
+  bool running_ = false;
+  bool stop_ = false;
+  bool failed_ = false;
+  std::string error_;
+  std::thread thread_;
+
+  void run();
+};
+
+#endif
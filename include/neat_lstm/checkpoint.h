@@ -0,0 +1,90 @@
+#ifndef NEAT_LSTM_CHECKPOINT_H
+#define NEAT_LSTM_CHECKPOINT_H
+
+#include <cstddef>
+#include <string>
+
+#include "neat_lstm/background_writer.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/record_io.h"
+#include "proto/checkpoint.pb.h"
+#include "proto/structures.pb.h"
+
+// Writes population checkpoints on a background thread, so evolution does not
+// stall on serialization and I/O. See proto/checkpoint.proto for the format.
+// Files are written under a temporary name and renamed when complete, so a
+// checkpoint is never left half-written.
+class CheckpointWriter {
+ public:
+  CheckpointWriter() {}
+
+  // Queues a checkpoint of the population and of the global state it depends
+  // on (innovation table, genome id counter and random seed) to be written to
+  // path. The state is captured before returning, and genomes are shared
+  // rather than copied, so the population may move on to the next generation
+  // right away. Fitnesses are saved as they are, so the population should be
+  // evaluated first: until then, those of reproduce() are placeholder zeros.
+  void write(const Population& population, const std::string& path);
+
+  // Blocks until all queued checkpoints are written. Returns false if any
+  // failed since the last call, with the reason in error().
+  bool flush();
+
+  const std::string& error() const;
+
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+ private:
+  struct Job {
+    // Shallow copy, keeping the genomes' arena alive
+    Population population;
+    CheckpointHeader header;
+    std::string path;
+  };
+
+  // Waits for queued checkpoints to be written on destruction
+  BackgroundWriter writer_;
+
+  // Serializes a job to its file. Returns an error message on failure.
+  static std::string save(Job& job);
+};
+
+// Reads a checkpoint by memory-mapping the file. Only the header is parsed on
+// open; genomes are parsed individually on request.
+class CheckpointReader {
+ public:
+  CheckpointReader() {}
+
+  // Maps the file and parses its header. Returns false if the file cannot be
+  // read or is not a valid checkpoint, with the reason in error().
+  bool open(const std::string& path);
+
+  const CheckpointHeader& header() const;
+
+  size_t genome_count() const;
+
+  // Parses the genome at the index. Returns false if the record is corrupt.
+  // May be called concurrently.
+  bool genome(size_t index, Genome* genome) const;
+
+  // Restores the innovation table, genome id counter and random seed saved in
+  // the checkpoint.
+  void restore_globals() const;
+
+  const std::string& error() const;
+
+  CheckpointReader(const CheckpointReader&) = delete;
+  CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+ private:
+  utils::MappedFile file_;
+  // Start of the genome records
+  size_t records_ = 0;
+  CheckpointHeader header_;
+  std::string error_;
+
+  void close();
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef NEAT_LSTM_COMPILED_NETWORK_H
+#define NEAT_LSTM_COMPILED_NETWORK_H
+
+#include <cstddef>
+#include <vector>
+
+#include "neat_lstm/activation.h"
+#include "neat_lstm/genome_delta.h"
+#include "neat_lstm/lstm_kernel.h"
+#include "proto/structures.pb.h"
+
+// A flattened evaluation plan of a genome, built once and evaluated many times.
+// Nodes are given dense indices in the topological order of the genome and the
+// incoming connections of each node are stored in a compressed sparse row
+// (CSR) layout, so a forward pass is a single sweep over contiguous arrays.
+// Disabled connections are dropped and bias connections are folded into a
+// per-node bias at construction time. LSTM units are evaluated with fused
+// LSTMKernels.
+// Weights and activations are stored as Scalar, float or double, converting
+// the genome's double weights once at construction. In double precision,
+// activations are identical to those of a Network built from the same genome.
+// Activation functions are computed in the given mode; activate_batch()
+// applies them over whole rows of samples with the array kernels.
+// The genome is not referenced after construction.
+// A network can be rebuilt in place for another genome, keeping its buffers;
+// once they have grown to fit the largest genome seen, rebuilding does not
+// allocate.
+template <typename Scalar>
+class CompiledNetwork {
+ public:
+  // An empty network without nodes, to be rebuilt for a genome.
+  CompiledNetwork();
+  CompiledNetwork(const Genome& genome,
+                  activation::Mode mode = activation::Mode::kExact);
+
+  // Compiles genome into this network as if newly constructed, reusing the
+  // buffers of the previous genome.
+  void rebuild(const Genome& genome,
+               activation::Mode mode = activation::Mode::kExact);
+
+  // Brings the network up to date with genome, which is the genome this
+  // network was compiled from after the changes recorded in delta. Weight-only
+  // deltas are patched in place in O(changed weights), keeping the current
+  // activations; any other delta rebuilds the network from genome. Returns true
+  // if the network was patched.
+  bool update(const Genome& genome, const GenomeDelta& delta);
+
+  // Performs the propagation of the input through the network.
+  void activate(const std::vector<double>& inputs);
+  // Same as above, reading input_size() values from inputs.
+  void activate(const Scalar* inputs);
+
+  // Evaluates batch_size independent samples in one call. inputs is a
+  // row-major batch_size * input_size() matrix, and outputs receives a
+  // row-major batch_size * output_size() matrix. Each sample gets the outputs
+  // a single activate() call would produce from the current state, but the
+  // state itself is left untouched. Only defined for networks without LSTM
+  // units, whose samples would otherwise depend on each other.
+  // Internally samples are laid out as structure-of-arrays, so the weighted
+  // sums of each node are computed as streaming loops over the batch.
+  void activate_batch(const Scalar* inputs, size_t batch_size,
+                      Scalar* outputs);
+
+  // Runs length timesteps of a sequence, continuing from the current state.
+  // inputs is a row-major length * input_size() matrix with the input of each
+  // timestep, and outputs receives a row-major length * output_size() matrix
+  // with the outputs after each timestep.
+  void activate_sequence(const Scalar* inputs, size_t length,
+                         Scalar* outputs);
+
+  // The state of the network, carried from one activate() to the next, is the
+  // activations of all nodes and the cell states and activations of all LSTM
+  // units. Resetting or restoring it lets one network evaluate many sequences
+  // instead of being rebuilt for each.
+
+  // Number of values in a saved state.
+  size_t state_size() const;
+  // Returns the network to its state after construction.
+  void reset_state();
+  // Copies state_size() values of the state to state.
+  void save_state(Scalar* state) const;
+  // Restores a state saved from this network.
+  void restore_state(const Scalar* state);
+
+  // Return the current activations of the output nodes. Behavior is undefined
+  // before the first call to activate().
+  std::vector<double> activations() const;
+  // Same as above, writing output_size() values to outputs.
+  void activations(Scalar* outputs) const;
+
+  int input_size() const;
+  int output_size() const;
+  // Number of nodes in the network, including input and bias nodes.
+  int node_count() const;
+  // Number of enabled, non-bias connections in the network.
+  int edge_count() const;
+
+ private:
+  activation::Mode mode_;
+
+  // Dense indices of the input, output and bias nodes
+  std::vector<int> input_indices_;
+  std::vector<int> output_indices_;
+  std::vector<int> bias_indices_;
+
+  // LSTM units and the dense indices of the nodes each one feeds. Unit u
+  // feeds lstm_out_indices_[lstm_out_offsets_[u], lstm_out_offsets_[u + 1]).
+  std::vector<LSTMKernel<Scalar>> lstm_kernels_;
+  std::vector<int> lstm_out_offsets_;
+  std::vector<int> lstm_out_indices_;
+  // Kernels left over from genomes with more LSTM units, reused by rebuild()
+  std::vector<LSTMKernel<Scalar>> spare_kernels_;
+
+  // Nodes whose activations are calculated on each pass, in topological order.
+  // Nodes without any incoming connections are never recalculated, matching
+  // Network.
+  std::vector<int> computed_nodes_;
+  std::vector<ActivationType> activation_types_;
+  std::vector<Scalar> biases_;
+
+  // Incoming edges of computed_nodes_[k] are stored in
+  // [edge_offsets_[k], edge_offsets_[k + 1]).
+  std::vector<int> edge_offsets_;
+  std::vector<int> edge_sources_;
+  std::vector<Scalar> edge_weights_;
+
+  // Where the weight of each connection of the genome is stored, by position
+  // in the genome: an index into edge_weights_, an encoded index into biases_,
+  // or unused.
+  std::vector<int> connection_slots_;
+
+  // Activations of all nodes by dense index
+  std::vector<Scalar> activations_;
+
+  // Scratch buffer of activate_batch() holding one row of kBatchTile samples
+  // per node. Kept between calls to avoid reallocation.
+  std::vector<Scalar> batch_activations_;
+
+  // Scratch buffers of rebuild(), kept to avoid reallocation: dense indices by
+  // node id, or -1, and the positions of the enabled connections of each node
+  // by target.
+  std::vector<int> node_indices_;
+  std::vector<bool> has_connections_;
+  std::vector<int> in_offsets_;
+  std::vector<int> in_cursors_;
+  std::vector<int> in_connections_;
+
+  // Returns the dense index of the node with the id.
+  int node_index(int id) const;
+
+  // Propagates the input activations through the network.
+  void propagate();
+};
+
+#endif
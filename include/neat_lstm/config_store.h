@@ -17,6 +17,9 @@ class ConfigStore {
   static const Config_Mutation& mutation();
   static const Config_Speciation& speciation();
   static const Config_Bounds& bounds();
+  static const Config_Reproduction& reproduction();
+  static const Config_Evaluation& evaluation();
+  static const Config_Islands& islands();
 
   // Reads a config object and stores it.
   void set(const Config& config);
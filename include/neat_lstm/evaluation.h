@@ -0,0 +1,40 @@
+#ifndef NEAT_LSTM_EVALUATION_H
+#define NEAT_LSTM_EVALUATION_H
+
+#include <cstddef>
+
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "proto/structures.pb.h"
+
+// Computes the fitness of genomes for a task.
+// evaluate() is called concurrently from multiple threads and must be
+// thread-safe.
+class Evaluator {
+ public:
+  virtual ~Evaluator() {}
+
+  // Returns the fitness of the genome. Higher is better.
+  virtual double evaluate(const Genome& genome) = 0;
+
+  // Number of timesteps fed to a network per evaluation.
+  virtual size_t sequence_length() const { return 1; }
+
+  // Estimates the relative cost of evaluating the genome, used to schedule
+  // expensive genomes first. Defaults to the number of multiply-adds of a
+  // forward pass times sequence_length().
+  virtual double cost(const Genome& genome) const;
+};
+
+// Evaluates all genomes of the population on the pool and stores the results
+// in the population's fitnesses. Genomes are scheduled in descending order of
+// estimated cost so that large genomes do not end up last on a single worker.
+// Scheduling buffers are kept per calling thread, so once a population as
+// large has been evaluated, the call allocates only what evaluator does.
+void evaluate(Population& population, Evaluator& evaluator, ThreadPool& pool);
+
+// Same as above on the calling thread, e.g. for the population of an island,
+// which already has a thread of its own.
+void evaluate(Population& population, Evaluator& evaluator);
+
+#endif
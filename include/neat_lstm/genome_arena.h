@@ -0,0 +1,51 @@
+#ifndef NEAT_LSTM_GENOME_ARENA_H
+#define NEAT_LSTM_GENOME_ARENA_H
+
+#include <google/protobuf/arena.h>
+#include <cstddef>
+#include <memory>
+
+#include "proto/structures.pb.h"
+
+// Allocates the genomes of a generation on a protobuf Arena, so that a genome
+// and all of its nodes and connections live in a few large blocks rather than
+// in separate heap allocations.
+// Genomes are owned by the arena and stay valid for as long as the arena is
+// held. Once the last holder releases it, the arena is reset and returned to
+// a pool for a later generation, which makes arenas double-buffered in a
+// generational loop: generation N is built on one arena while generation N-1
+// still holds the other. An arena's first block grows to the largest space a
+// generation has used, so a steady-state generation allocated from a single
+// thread fits in one block.
+class GenomeArena {
+ public:
+  // Returns an arena from the pool, or a new one if the pool is empty.
+  static std::shared_ptr<GenomeArena> acquire();
+
+  // Allocates an empty genome on the arena.
+  Genome* create();
+
+  // Allocates a copy of the genome on the arena.
+  Genome* copy(const Genome& genome);
+
+  // Bytes allocated by the arena so far.
+  size_t space_allocated() const;
+
+  GenomeArena(const GenomeArena&) = delete;
+  GenomeArena& operator=(const GenomeArena&) = delete;
+
+ private:
+  std::unique_ptr<char[]> initial_block_;
+  size_t initial_block_size_ = 0;
+  std::unique_ptr<google::protobuf::Arena> arena_;
+
+  GenomeArena();
+
+  // Frees all genomes, growing the initial block if the arena outgrew it.
+  void reset();
+
+  // Returns an arena to the pool once its last holder releases it.
+  static void release(GenomeArena* arena);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef NEAT_LSTM_GENOME_BUILDER_H
+#define NEAT_LSTM_GENOME_BUILDER_H
+
+#include <vector>
+
+#include "proto/structures.pb.h"
+
+// A mutable working set over a genome for applying several structural
+// mutations in a row. Nodes and connections stay owned by the genome, while the
+// builder keeps their order as arrays of pointers, copied on first use, and
+// build() writes the order back into the genome once. Connections are kept in
+// InnovationRegistry::precedes() order, so a connection is found by committed
+// innovation in O(log n).
+// Finding a node by id or a connection by (in, out) is an O(n) scan, and an
+// insertion shifts O(n) pointers, instead of moving elements through the
+// genome's lists one swap at a time.
+// mutate_all() applies at most a few structural mutations to an offspring, so
+// hashed indexes of the whole genome would cost more to build than the scans
+// they save.
+// The node and connection lists of the genome must not be used between
+// structural changes and build(), but fields of their elements may be.
+class GenomeBuilder {
+ public:
+  explicit GenomeBuilder(Genome* genome);
+
+  // Writes the working order back into the genome, if anything changed.
+  ~GenomeBuilder();
+
+  Genome& genome();
+
+  // Nodes in topological order.
+  int node_count();
+  const Node& node(int position);
+
+  // Connections in InnovationRegistry::precedes() order.
+  int connection_count();
+  Connection* connection(int position);
+
+  // Returns the position of the connection with the innovation, or -1.
+  // Provisional innovations are scanned for, as they are ordered by (in, out).
+  int find_connection(int innovation);
+
+  // Returns true if there is a connection from in_node to out_node.
+  bool has_connection(int in_node, int out_node);
+
+  // Allocates a node or connection for insertion, on the genome's arena if it
+  // has one. The arena then owns it right away; otherwise the caller does
+  // until insert_node() or insert_connection() passes it to the genome.
+  Node* new_node();
+  Connection* new_connection();
+
+  // Places a node from new_node() right before the node with the target id.
+  // Returns the position of the node.
+  int insert_node(Node* node, int target_id);
+
+  // Places a connection from new_connection() in InnovationRegistry::precedes()
+  // order. Returns the position of the connection.
+  int insert_connection(Connection* connection);
+
+  // Writes the working order back into the genome's lists.
+  void build();
+
+  GenomeBuilder(const GenomeBuilder&) = delete;
+  GenomeBuilder& operator=(const GenomeBuilder&) = delete;
+
+ private:
+  Genome* genome_;
+  bool indexed_ = false;
+  bool changed_ = false;
+
+  std::vector<Node*> nodes_;
+  std::vector<Connection*> connections_;
+
+  // Copies the order of the genome's lists.
+  void index();
+};
+
+#endif
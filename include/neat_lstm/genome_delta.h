@@ -0,0 +1,52 @@
+#ifndef NEAT_LSTM_GENOME_DELTA_H
+#define NEAT_LSTM_GENOME_DELTA_H
+
+#include <vector>
+
+// Changes made to a genome by mutations, so that structures derived from the
+// genome before the mutations can be patched instead of rebuilt.
+// Changes are recorded by position in the genome's node and connection lists
+// at the time of the change. Positions of weight changes are only stable while
+// the delta is weights-only, as structural changes may shift them.
+class GenomeDelta {
+ public:
+  enum class Type {
+    // A node was inserted at the index of the node list
+    kNodeInserted,
+    // A connection was inserted at the index of the connection list
+    kConnectionAdded,
+    // The connection at the index was enabled or disabled
+    kConnectionToggled,
+  };
+
+  struct Change {
+    Type type;
+    int index;
+  };
+
+  // Records a new weight of the connection at the position.
+  void weight_changed(int connection);
+
+  // Records a change to the structure of the genome.
+  void structure_changed(Type type, int index);
+
+  // Returns true if all recorded changes are connection weights.
+  bool weights_only() const;
+
+  bool empty() const;
+
+  // Positions of connections whose weights changed, in order of the changes.
+  const std::vector<int>& weights() const;
+
+  // Structural changes, in order.
+  const std::vector<Change>& changes() const;
+
+  // Forgets all changes, keeping the allocated capacity.
+  void clear();
+
+ private:
+  std::vector<int> weights_;
+  std::vector<Change> changes_;
+};
+
+#endif
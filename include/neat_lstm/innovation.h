@@ -1,26 +1,130 @@
 #ifndef NEAT_LSTM_INNOVATION_H
 #define NEAT_LSTM_INNOVATION_H
 
+#include <atomic>
+#include <cstddef>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
-// Maintains the global innovation numbers of every gene mutated.
+#include "proto/structures.pb.h"
+
+// A table of the innovation numbers of every gene mutated.
 // Innovation numbers are looked up based on the input and output nodes.
-class Innovation {
+//
+// get() may be called concurrently. Connections not seen in previous
+// generations are given provisional numbers, which sort after all committed
+// numbers. At the generation boundary commit() assigns final numbers to them
+// in (in, out) order, so the numbering does not depend on the order in which
+// threads asked for them, and renumber() rewrites the genomes of the new
+// generation. commit(), renumber() and prune() must not run concurrently with
+// get().
+class InnovationRegistry {
  public:
-  // Returns the current global max innovation number.
-  static int get_max();
+  InnovationRegistry();
 
-  // Returns a known innovation number if found, or returns a newly
-  // incremented innovation number if not.
-  static int get(int in_node_id, int out_node_id);
+  // Returns the max committed innovation number.
+  int get_max() const;
+
+  // Returns a known innovation number if found, or a provisional one if not.
+  int get(int in_node_id, int out_node_id);
+
+  // Assigns final innovation numbers to all provisional ones.
+  void commit();
+
+  // Replaces provisional innovation numbers of the last commit() in the genome
+  // with their final values, keeping connections sorted.
+  void renumber(Genome& genome) const;
+
+  // Renumbers the connections of a genome numbered by another registry, e.g.
+  // a migrant from another island, with the numbers of this one, keeping
+  // connections sorted. Connections new to this registry get provisional
+  // numbers, to be finalized by commit() and renumber().
+  void adopt(Genome& genome);
+
+  // Drops committed entries that no connection in the genomes refers to. The
+  // max innovation number is unaffected, so dropped numbers are not reused.
+  void prune(const std::vector<const Genome*>& genomes);
+
+  // Number of committed entries.
+  size_t size() const;
+
+  // A committed innovation number of a connection.
+  struct Entry {
+    int in_node_id;
+    int out_node_id;
+    int innovation;
+  };
+
+  // Returns all committed entries, in (in, out) order.
+  std::vector<Entry> entries() const;
+
+  // Replaces the registry's state with committed entries and a max innovation
+  // number, e.g. as saved from entries() and get_max(). Must not run
+  // concurrently with get().
+  void restore(const std::vector<Entry>& entries, int max_innovation);
+
+  // Returns whether the innovation number is provisional.
+  static bool provisional(int innovation);
+
+  // Order of the connections of a genome: by innovation number, except that
+  // provisional connections, which come last, are ordered by (in, out). That
+  // is the order commit() numbers them in, so it is already their final order,
+  // and it does not depend on which thread first asked for a pair.
+  static bool precedes(const Connection& a, const Connection& b);
+
+  InnovationRegistry(const InnovationRegistry&) = delete;
+  InnovationRegistry& operator=(const InnovationRegistry&) = delete;
 
  private:
-  static int max_innovation_num_;
-  static std::unordered_map<long, int> innovations_;
+  // New entries are spread over shards to reduce lock contention
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<long, int> innovations;
+  };
+  static const size_t kShards = 16;
+
+  int max_innovation_num_ = 0;
+  // Read without locking; only modified by commit() and prune().
+  std::unordered_map<long, int> innovations_;
+
+  Shard shards_[kShards];
+  std::atomic<int> provisional_count_;
+  // Final innovation numbers of the last commit(), by provisional offset
+  std::vector<int> renumbering_;
 
   // Technically not a hashing function, just a lazy way to store pairs of ids
   // to innovation numbers.
   static long hash(int in_node_id, int out_node_id);
 };
 
+// Maintains the global innovation numbers of every gene mutated, through a
+// process-wide InnovationRegistry, or through the registry of the innermost
+// ScopedRegistry of the calling thread.
+class Innovation {
+ public:
+  // Returns the current global max innovation number.
+  static int get_max();
+
+  // Returns a known innovation number if found, or returns a new provisional
+  // innovation number if not.
+  static int get(int in_node_id, int out_node_id);
+
+  static InnovationRegistry& registry();
+};
+
+// Directs Innovation on the current thread to a registry for as long as the
+// object lives, e.g. to the registry of an island. Scopes can be nested.
+class ScopedRegistry {
+ public:
+  explicit ScopedRegistry(InnovationRegistry& registry);
+  ~ScopedRegistry();
+
+  ScopedRegistry(const ScopedRegistry&) = delete;
+  ScopedRegistry& operator=(const ScopedRegistry&) = delete;
+
+ private:
+  InnovationRegistry* previous_;
+};
+
 #endif
@@ -0,0 +1,101 @@
+#ifndef NEAT_LSTM_ISLAND_H
+#define NEAT_LSTM_ISLAND_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "proto/structures.pb.h"
+
+// The state that populations would otherwise share through process-wide
+// globals: the genome id counter, the innovation registry and the random
+// stream of each generation.
+// Island i of count assigns the genome ids i, i + count, i + 2 * count..., so
+// ids are unique across islands and migrants keep theirs. Distinct ids also
+// give distinct per-genome random streams.
+class Island {
+ public:
+  Island(int index, int count);
+
+  int index() const;
+
+  // Returns a new genome id of the island.
+  int next_genome_id();
+
+  InnovationRegistry& registry();
+
+  Island(const Island&) = delete;
+  Island& operator=(const Island&) = delete;
+
+ private:
+  int index_;
+  int count_;
+  // Number of ids assigned so far
+  int genome_ids_ = 0;
+  InnovationRegistry registry_;
+};
+
+// Evolves several populations side by side, each on an island of its own:
+// islands run on separate threads with their own species, innovation numbers
+// and random streams. Speciation and reproduction thus cost the sum over
+// islands of their quadratic and serial parts, instead of those of a single
+// population of the total size.
+// Every migration_interval generations the islands pause, and copies of the
+// fittest migrants genomes of each island replace the least fit genomes of its
+// neighbours: the next island of a ring, or every other island if fully
+// connected. Migrants are renumbered with the innovation numbers of their new
+// island, which is then re-speciated.
+// Results depend only on the seed of the run, not on the number of threads.
+// Island populations cannot be checkpointed, as CheckpointWriter only saves
+// the process-wide state.
+class IslandModel {
+ public:
+  enum class Topology { kRing, kFullyConnected };
+
+  struct Options {
+    size_t islands = 4;
+    // Genomes per island
+    size_t population_size = 150;
+    int migration_interval = 10;
+    size_t migrants = 2;
+    Topology topology = Topology::kRing;
+  };
+
+  // Creates the 1st generation of every island from the seed. Islands run on
+  // the pool, one task each, or on the calling thread if there is none.
+  IslandModel(const Genome& seed, const Options& options,
+              ThreadPool* pool = nullptr);
+
+  // Runs migration_interval generations on every island, evaluating each with
+  // evaluator from all islands concurrently, and then migrates. The first call
+  // starts with the 1st generation, later ones with its reproduction. The last
+  // generation of every island is left evaluated.
+  void run_epoch(Evaluator& evaluator);
+
+  size_t size() const;
+  const Population& population(size_t island) const;
+  // Generation of the islands, which advance in lockstep.
+  int generation() const;
+
+  IslandModel(const IslandModel&) = delete;
+  IslandModel& operator=(const IslandModel&) = delete;
+
+ private:
+  Options options_;
+  ThreadPool* pool_;
+  std::vector<std::unique_ptr<Island>> islands_;
+  std::vector<std::unique_ptr<Population>> populations_;
+  bool evaluated_ = false;
+
+  // Runs task(island) for every island, on the pool if there is one.
+  void for_each_island(const std::function<void(size_t)>& task);
+
+  void migrate();
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef NEAT_LSTM_JOURNAL_H
+#define NEAT_LSTM_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "neat_lstm/background_writer.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/record_io.h"
+#include "proto/journal.pb.h"
+
+// Records every genome of every generation, with its fitness, species and
+// parents, for offline analysis. See proto/journal.proto for the format.
+// Generations are serialized on a background thread into a buffered segment
+// file that stays open across generations, so journaling costs evolution
+// little more than copying the population's per-genome arrays. Segments are
+// written under a temporary name and renamed once their index is written, so
+// readers only ever see complete segments.
+class JournalWriter {
+ public:
+  // Journals into the directory, creating it if needed, and starts a new
+  // segment every generations_per_segment generations. Segment i holds
+  // generations [i * generations_per_segment + 1,
+  // (i + 1) * generations_per_segment]. When a resumed run reopens a complete
+  // segment, the records of the generations before the first one appended are
+  // kept, and those of the later ones are replaced.
+  explicit JournalWriter(const std::string& directory,
+                         int generations_per_segment = 50);
+
+  // Completes the open segment.
+  ~JournalWriter();
+
+  // Queues the records of an evaluated population. Generations must be
+  // appended in ascending order.
+  void append(const Population& population);
+
+  // Blocks until appended generations are written, and completes the open
+  // segment. Nothing may be appended afterwards. Returns false if any write
+  // failed, with the reason in error().
+  bool close();
+
+  const std::string& error() const;
+
+  JournalWriter(const JournalWriter&) = delete;
+  JournalWriter& operator=(const JournalWriter&) = delete;
+
+ private:
+  const std::string directory_;
+  const int generations_per_segment_;
+
+  // State of the open segment, only used on the writer thread
+  int segment_ = -1;
+  std::ofstream output_;
+  std::vector<char> buffer_;
+  uint64_t offset_ = 0;
+  JournalIndex index_;
+
+  // Declared last, so that it finishes before the state above is destroyed
+  BackgroundWriter writer_;
+
+  // Writes the records of a generation, opening a new segment if needed.
+  std::string write(const Population& population);
+
+  // Copies the records of the generations before generation from the complete
+  // file of the open segment, if there is one.
+  std::string keep_earlier(int generation);
+
+  // Writes the index of the open segment and renames it to its final name.
+  std::string finish_segment();
+
+  std::string segment_path(int segment) const;
+};
+
+// Reads a journal by memory-mapping its segments. Only the indexes are parsed
+// on open, so a generation or a genome is found without scanning records.
+class JournalReader {
+ public:
+  JournalReader() {}
+
+  // Maps the complete segments of the directory and parses their indexes.
+  // Returns false if the directory cannot be listed or a segment is corrupt,
+  // with the reason in error().
+  bool open(const std::string& directory);
+
+  // Range of journaled generations, or -1 if the journal is empty.
+  int first_generation() const;
+  int last_generation() const;
+
+  // Parses the records of a generation, in population order. Returns false if
+  // the generation is not journaled or a record is corrupt.
+  bool generation(int generation, std::vector<JournalRecord>* records) const;
+
+  // Parses the records of the genome with the id, in order of generation. A
+  // genome copied unchanged into later generations keeps its id, so it may
+  // have several. Returns false if there is none or a record is corrupt.
+  bool genome(int id, std::vector<JournalRecord>* records) const;
+
+  const std::string& error() const;
+
+  JournalReader(const JournalReader&) = delete;
+  JournalReader& operator=(const JournalReader&) = delete;
+
+ private:
+  struct Segment {
+    utils::MappedFile file;
+    JournalIndex index;
+  };
+
+  // In ascending order of generation
+  std::vector<Segment> segments_;
+  std::string error_;
+
+  // Parses the record at the offset of a segment.
+  bool record(const Segment& segment, uint64_t offset,
+              JournalRecord* record) const;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef NEAT_LSTM_LSTM_KERNEL_H
+#define NEAT_LSTM_LSTM_KERNEL_H
+
+#include "neat_lstm/activation.h"
+#include "neat_lstm/utils/aligned_allocator.h"
+#include "proto/structures.pb.h"
+
+// A fused evaluation kernel for a single LSTM unit, computing in Scalar
+// (float or double). The genome's double weights are converted once at
+// construction.
+// The weights of all four gates are repacked at construction so that a
+// timestep is one pass over the concatenated [h_{t-1}, x_t] vector: row i of
+// the packed matrix holds the input, forget, state and output weights of cell
+// i back to back, each padded to a multiple of the SIMD width. Uses AVX-512 or
+// AVX2 when the build targets them, with a scalar fallback otherwise. In
+// single precision a vector holds twice as many lanes. Gate activations are
+// applied over all cells at once with the array kernels of activation, in the
+// given mode.
+// All buffers are allocated at construction; step() does not allocate, and
+// neither does rebuild() for a unit that fits in the buffers.
+template <typename Scalar>
+class LSTMKernel {
+ public:
+  LSTMKernel(const LSTMUnit& lstm_unit, int input_size,
+             activation::Mode mode = activation::Mode::kExact);
+
+  // Repacks the kernel for lstm_unit as if newly constructed, reusing the
+  // buffers of the previous unit.
+  void rebuild(const LSTMUnit& lstm_unit, int input_size,
+               activation::Mode mode = activation::Mode::kExact);
+
+  int capacity() const;
+  int input_size() const;
+
+  // Buffer of input_size() values that are read by the next step().
+  Scalar* inputs();
+
+  // Advances the unit by one timestep, using the previous activations and the
+  // values in inputs().
+  void step();
+
+  // Activations of the capacity() cells after the last step(). Zero before
+  // the first step().
+  const Scalar* activations() const;
+  // Cell state of the capacity() cells after the last step().
+  const Scalar* state() const;
+
+  // Clears the cell state and activations.
+  void reset();
+
+  // Number of values in a saved state: the cell state and activations.
+  int state_size() const;
+  // Copies state_size() values of the state to state.
+  void save_state(Scalar* state) const;
+  // Restores a state saved from a kernel of the same capacity.
+  void restore_state(const Scalar* state);
+
+ private:
+  int capacity_;
+  int input_size_;
+  activation::Mode mode_;
+  // Padded length of the concatenated [h_{t-1}, x_t] vector
+  int stride_;
+
+  // Packed capacity * 4 * stride_ weights
+  utils::aligned_vector<Scalar> weights_;
+  // Input, forget, state and output biases
+  Scalar biases_[4];
+
+  // [h_{t-1}, x_t], zero padded to stride_
+  utils::aligned_vector<Scalar> variables_;
+  // Input, forget, state and output gates of all cells, one gate after the
+  // other
+  utils::aligned_vector<Scalar> gates_;
+  utils::aligned_vector<Scalar> state_;
+  utils::aligned_vector<Scalar> activations_;
+};
+
+#endif
@@ -1,40 +1,48 @@
 #ifndef NEAT_LSTM_MUTATIONS_H
 #define NEAT_LSTM_MUTATIONS_H
 
+#include "neat_lstm/genome_builder.h"
+#include "neat_lstm/genome_delta.h"
 #include "proto/structures.pb.h"
 
 // Each mutation operation has an in-place version and a copy version.
+// If a delta is given, mutations record the changes they make to it.
+// Structural mutations also have a version applying to a GenomeBuilder, which
+// makes a series of them on a large genome cheap.
 namespace mutation {
 
 // Probabilistically performs all mutation operations based on the configuration
-// parameters.
+// parameters. Structural mutations are applied through one GenomeBuilder.
 // When LSTM features are mutated, other types of mutations are not performed.
-void mutate_all(Genome& source);
+void mutate_all(Genome& source, GenomeDelta* delta = nullptr);
 
 // Mutation to add a random conneciton.
-void add_connection(Genome& source);
+void add_connection(Genome& source, GenomeDelta* delta = nullptr);
+void add_connection(GenomeBuilder& builder, GenomeDelta* delta = nullptr);
 
 // Mutation to add a random node. Disables a connection and inserts 2 new
 // connections and a new node between the source and target of the original
 // connection.
-void add_node(Genome& source);
+void add_node(Genome& source, GenomeDelta* delta = nullptr);
+void add_node(GenomeBuilder& builder, GenomeDelta* delta = nullptr);
 
 // Mutation to toggle a random connection.
-void toggle_connection(Genome& source);
+void toggle_connection(Genome& source, GenomeDelta* delta = nullptr);
+void toggle_connection(GenomeBuilder& builder, GenomeDelta* delta = nullptr);
 
 // Mutation to perturb each connection weight.
 // A connection may be assigned a random weight based on config parameters.
-void perturb_weights(Genome& genome);
+void perturb_weights(Genome& genome, GenomeDelta* delta = nullptr);
 
 // Mutation to add a new LSTM unit to the stack of the genome.
 // The output nodes of the predecessor are moved to the new unit.
-void add_lstm_unit(Genome& source);
+void add_lstm_unit(Genome& source, GenomeDelta* delta = nullptr);
 
 // Mutation to increase the size of a random LSTM unit's state by 1.
 // The unit is expanded and a new hidden node is created that connects to all
 // output nodes with weights of 1.
 // TODO: Evaluate weight selection
-void expand_lstm_state(Genome& source);
+void expand_lstm_state(Genome& source, GenomeDelta* delta = nullptr);
 
 }  // namespace mutation
 
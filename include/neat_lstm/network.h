@@ -2,7 +2,6 @@
 #define NEAT_LSTM_NETWORK_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "neat_lstm/lstm_unit_gene.h"
@@ -11,9 +10,11 @@
 
 // A network is the phenotype representation of a genome and acts as an organism
 // that can be bred with others.
+// The network refers to its genome instead of copying it, so the genome must
+// outlive the network.
 class Network {
  public:
-  const Genome genome;
+  const Genome& genome;
 
   Network(const Genome& genome);
 
@@ -25,15 +26,18 @@ class Network {
   // before the first call to activate().
   std::vector<double> activations() const;
 
+  // Clears the activations of all nodes and the state of all LSTM units, as
+  // after construction.
+  void reset_state();
+
   NodeGene* mutable_node_gene_by_id(int id);
   NodeGene* mutable_node_gene_by_index(int index);
 
  private:
   // Map of node ids to node genes
   std::unordered_map<int, NodeGene> node_genes_;
-  // Map of node ids to the set of their incoming connections
-  std::unordered_map<int, std::unordered_set<const Connection*>>
-      in_connections_;
+  // Map of node ids to their incoming connections, in genome order
+  std::unordered_map<int, std::vector<const Connection*>> in_connections_;
   std::vector<LSTMUnitGene> lstm_unit_genes_;
   std::vector<NodeGene*> input_node_genes_;
   std::vector<NodeGene*> output_node_genes_;
@@ -0,0 +1,30 @@
+#ifndef NEAT_LSTM_NETWORK_POOL_H
+#define NEAT_LSTM_NETWORK_POOL_H
+
+#include "neat_lstm/activation.h"
+#include "neat_lstm/compiled_network.h"
+#include "proto/structures.pb.h"
+
+// Evaluation buffers that are rebound to one genome after another instead of
+// building a fresh network for each. The buffers grow to the largest genome
+// seen and are never freed, so once a population's genomes have been seen,
+// acquiring a network for any of them performs no heap allocation.
+// A pool is not thread-safe; each evaluating thread uses its own through
+// local().
+template <typename Scalar>
+class NetworkPool {
+ public:
+  // Returns the network of the pool rebuilt for genome. The genome is only
+  // read during the call, never copied or referenced afterwards. The network
+  // stays valid until the next acquire() on the pool.
+  CompiledNetwork<Scalar>& acquire(
+      const Genome& genome, activation::Mode mode = activation::Mode::kExact);
+
+  // The pool of the calling thread.
+  static NetworkPool& local();
+
+ private:
+  CompiledNetwork<Scalar> network_;
+};
+
+#endif
@@ -1,40 +1,109 @@
 #ifndef NEAT_LSTM_POPULATION_H
 #define NEAT_LSTM_POPULATION_H
 
+#include <cstddef>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
+#include "neat_lstm/genome_arena.h"
+#include "neat_lstm/innovation.h"
 #include "neat_lstm/network.h"
+#include "neat_lstm/selection.h"
 #include "neat_lstm/species.h"
+#include "neat_lstm/thread_pool.h"
 #include "proto/structures.pb.h"
 
+class CheckpointReader;
+class Island;
+
+// Ids of the parents of a genome, -1 where there is none. Crossover offspring
+// have two parents, other offspring one, and genomes of a 1st generation none.
+struct Parents {
+  int first = -1;
+  int second = -1;
+};
+
+// Genomes of a population are addressed by their dense index in genomes_, and
+// per-genome data is kept in arrays parallel to it. Genomes of a species are
+// contiguous, so species are index ranges.
 class Population {
  public:
-  std::unordered_map<std::shared_ptr<Genome>, double> g_fitnesses_;
-  std::vector<std::shared_ptr<Genome>> genomes_;
+  // Genomes of this generation, owned by the population's arena
+  std::vector<Genome*> genomes_;
+  // Fitness of each genome, filled in by evaluation
+  std::vector<double> fitnesses_;
   // Construct a 1st generation population using the seed genome.
   // Subsequent generations should be formed as the result of reproduction.
-  Population(const Genome& seed, size_t size);
+  // If a thread pool is given, it is used by this and all later generations,
+  // and so is the selector, which defaults to the one of the config.
+  // If an island is given, genome ids, innovation numbers and the draws of
+  // all generations come from it instead of the process-wide state, so that
+  // populations of different islands can evolve concurrently.
+  Population(const Genome& seed, size_t size,
+             ThreadPool* thread_pool = nullptr,
+             std::shared_ptr<const selection::Selector> selector = nullptr,
+             Island* island = nullptr);
 
-  // Bucket organisms in this population into species.
+  // Restores a population saved by a CheckpointWriter, along with the global
+  // state it depends on (see CheckpointReader::restore_globals()). Genomes are
+  // parsed on the thread pool. Returns null if a genome record is corrupt.
+  static std::unique_ptr<Population> restore(
+      const CheckpointReader& checkpoint, ThreadPool* thread_pool = nullptr,
+      std::shared_ptr<const selection::Selector> selector = nullptr);
+
+  // Bucket organisms in this population into species, replacing any previous
+  // speciation. Genomes are scored against species representatives in
+  // parallel, but are assigned in order, so the result is the same as
+  // assigning each genome to the first compatible species one at a time.
+  // Genomes, their fitnesses and parents are then reordered to make species
+  // contiguous, keeping the relative order of the genomes of a species.
   void speciate();
 
   // Perform reproduction/mutations on a species-basis to produce the next
-  // generation of the same size.
+  // generation of the same size. Offspring are allocated to species by
+  // adjusted fitness, planned by the selector, and bred on the thread pool.
   Population reproduce();
 
   int generation() const;
 
   size_t species_size() const;
 
+  const std::vector<Species>& species() const;
+
+  // Index into species() of each genome.
+  const std::vector<size_t>& species_ids() const;
+
+  // Fitness of each genome shared among its species, as computed by the last
+  // call to reproduce().
+  const std::vector<double>& adjusted_fitnesses() const;
+
+  // Parents of each genome. Unknown for restored populations.
+  const std::vector<Parents>& parents() const;
+
+  // Replaces the genome at index with a copy of genome, e.g. a migrant from
+  // another population, with the fitness and unknown parents. Returns the
+  // copy. speciate() should follow once all replacements are made.
+  Genome* replace(size_t index, const Genome& genome, double fitness);
+
  private:
   int generation_ = 1;
   size_t size_;
-  std::vector<std::shared_ptr<Species>> species_;
-
+  std::vector<Species> species_;
+  std::vector<size_t> species_ids_;
+  std::vector<double> adjusted_fitnesses_;
+  std::vector<Parents> parents_;
+  ThreadPool* thread_pool_ = nullptr;
+  std::shared_ptr<const selection::Selector> selector_;
+  Island* island_ = nullptr;
+  // Arena holding the genomes of this generation
+  std::shared_ptr<GenomeArena> arena_;
 
   Population() : size_(0) {}
+
+  // Returns a new genome id, from the island if there is one.
+  int next_genome_id();
+  // The registry innovation numbers of the genomes come from.
+  InnovationRegistry& registry();
 };
 
 #endif
@@ -11,6 +11,15 @@ namespace reproduction {
 // TODO: Consider crossing over weights that match
 Genome crossover(const Genome& more_fit, const Genome& less_fit);
 
+// Same as above, writing into an empty child genome (e.g. one allocated on an
+// arena). The child's id is left for the caller to assign, so that children
+// can be bred concurrently with ids fixed in advance.
+// The child is sized once and the random choices of matching genes are drawn
+// in one batch. Connections are allocated on the child's arena, or reuse the
+// cleared connections of a child that was Clear()ed, so a reused child
+// crosses over without heap allocation.
+void crossover(const Genome& more_fit, const Genome& less_fit, Genome* child);
+
 }  // namespace reproduction
 
 #endif
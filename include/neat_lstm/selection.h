@@ -0,0 +1,88 @@
+#ifndef NEAT_LSTM_SELECTION_H
+#define NEAT_LSTM_SELECTION_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "proto/config.pb.h"
+
+namespace selection {
+
+// How an offspring is produced from its parents.
+enum class Operator {
+  // Unchanged copy of parent_a, keeping its id
+  kCopy,
+  // Mutated copy of parent_a
+  kMutate,
+  // Mutated crossover of parent_a, the more fit parent, and parent_b
+  kCrossover,
+};
+
+// An entry of a mating plan, producing one offspring. Parents are population
+// indices.
+struct Mating {
+  size_t parent_a;
+  size_t parent_b;
+  Operator op;
+};
+
+// Chooses the parents of a species' offspring. Selectors only read fitnesses
+// and draw from the current random stream, so a plan is reproducible and its
+// matings can be carried out in any order, or in parallel.
+class Selector {
+ public:
+  virtual ~Selector() {}
+
+  // Appends count matings between the genomes [begin, end) of the population
+  // to the plan, given the fitnesses of the population.
+  virtual void plan(const std::vector<double>& fitnesses, size_t begin,
+                    size_t end, size_t count,
+                    std::vector<Mating>* plan) const = 0;
+};
+
+// Keeps the fittest ceil(sqrt(2 * count)) genomes as parents, copies the
+// fittest one unchanged, crosses over pairs of them, and fills any remaining
+// places with mutated copies of the parents.
+class TruncationSelector : public Selector {
+ public:
+  void plan(const std::vector<double>& fitnesses, size_t begin, size_t end,
+            size_t count, std::vector<Mating>* plan) const override;
+};
+
+// Keeps the fittest genome and picks each parent of the remaining offspring as
+// the fittest of tournament_size random genomes.
+class TournamentSelector : public Selector {
+ public:
+  explicit TournamentSelector(size_t tournament_size);
+
+  void plan(const std::vector<double>& fitnesses, size_t begin, size_t end,
+            size_t count, std::vector<Mating>* plan) const override;
+
+ private:
+  size_t tournament_size_;
+};
+
+// Keeps the fittest genome and picks the parents of the remaining offspring by
+// stochastic universal sampling: evenly spaced pointers over the cumulative
+// fitness, which selects genomes in proportion to fitness with minimal spread.
+// Negative fitnesses count as 0.
+class StochasticUniversalSelector : public Selector {
+ public:
+  void plan(const std::vector<double>& fitnesses, size_t begin, size_t end,
+            size_t count, std::vector<Mating>* plan) const override;
+};
+
+// Creates the selector specified by the config.
+std::unique_ptr<Selector> create(const Config_Reproduction& config);
+
+// Divides total offspring among species in proportion to their shares using
+// the largest remainder method, so that the counts add up to exactly total.
+// Ties in remainders go to the earlier species. If no share is positive,
+// offspring are divided evenly.
+void allocate_offspring(const std::vector<double>& shares, size_t total,
+                        std::vector<size_t>* counts);
+
+}  // namespace selection
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef NEAT_LSTM_SEQUENCE_TRIE_H
+#define NEAT_LSTM_SEQUENCE_TRIE_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "neat_lstm/compiled_network.h"
+
+// A dataset of input sequences stored as a trie of timesteps, so that a
+// network evaluates each prefix shared by several sequences only once.
+// evaluate() walks the trie depth first, saving the network state where
+// sequences branch and restoring it before each further branch. Snapshots are
+// kept within a memory cap; when a new one does not fit, the snapshot that is
+// cheapest to recompute, i.e. whose pending restores times the timesteps
+// to replay from the previous snapshot is smallest, is evicted and replayed
+// from that snapshot when needed.
+// Outputs are identical to evaluating each sequence from a reset state.
+// The trie is read-only during evaluation, so one trie may be evaluated by
+// several networks concurrently.
+template <typename Scalar>
+class SequenceTrie {
+ public:
+  static const size_t kDefaultMemoryCap = 64 << 20;
+
+  explicit SequenceTrie(size_t input_size);
+
+  // Adds a sequence given as a row-major length * input_size matrix with the
+  // input of each timestep. Returns the index of the sequence.
+  size_t add(const Scalar* inputs, size_t length);
+
+  size_t input_size() const;
+  size_t sequence_count() const;
+  // Number of timesteps over all sequences, and the number stored in the trie
+  // after sharing prefixes.
+  size_t total_length() const;
+  size_t node_count() const;
+
+  // Evaluates all sequences, each starting from the reset state of the
+  // network, which is left in an unspecified state. outputs receives the
+  // outputs of the sequences in order of addition, each one a row-major
+  // length * output_size() matrix with the outputs after each timestep.
+  // Saved states are limited to memory_cap bytes. Returns the number of
+  // timesteps evaluated, including those replayed after evictions.
+  size_t evaluate(CompiledNetwork<Scalar>& network, Scalar* outputs,
+                  size_t memory_cap = kDefaultMemoryCap) const;
+
+ private:
+  // Trie nodes, each a timestep. Node 0 is the root, which has no input and
+  // stands for the reset state.
+  struct Node {
+    int parent;
+    int first_child;
+    int next_sibling;
+    // Distance from the root
+    size_t depth;
+    // Row of outputs that evaluate() writes the outputs of the node to: the
+    // timestep of the first sequence through it
+    size_t output_row;
+  };
+
+  size_t input_size_;
+  std::vector<Node> nodes_;
+  // Input of each node by index, input_size_ values each
+  std::vector<Scalar> inputs_;
+  // Children by hash of parent and input
+  std::unordered_multimap<size_t, int> children_;
+
+  // Last node and first output row of each sequence
+  std::vector<int> sequence_ends_;
+  std::vector<size_t> sequence_rows_;
+  size_t total_length_ = 0;
+
+  // Returns the child of parent with the input, adding it if there is none
+  // with outputs at output_row.
+  int child(int parent, const Scalar* input, size_t output_row);
+};
+
+#endif
@@ -1,45 +1,31 @@
 #ifndef NEAT_LSTM_SPECIES_H
 #define NEAT_LSTM_SPECIES_H
 
-#include <memory>
-#include <unordered_map>
-#include <vector>
-
-#include "proto/structures.pb.h"
+#include <cstddef>
 
 // A species is a grouping of genomes that are compatible with each other.
+// Genomes of a species are stored contiguously in their population, so a
+// species is the range [begin, end) of population indices. The first genome of
+// the range is the representative.
+// Parents are chosen by a selection::Selector over the species' range.
 // TODO: Consider adding generational context to prune stale species
 class Species {
  public:
-  // Species are created with a representative genome.
-  Species(std::shared_ptr<Genome> representative)
-      : representative_(representative) {
-    genomes_.push_back(representative);
-  }
-
-  std::shared_ptr<Genome> representative() const;
+  Species(size_t begin, size_t end) : begin_(begin), end_(end) {}
 
-  // Adds a genome to this species.
-  void add_genome(std::shared_ptr<Genome> genome);
+  // Population index of the representative genome.
+  size_t representative() const;
 
-  // Returns the genomes in this species.
-  const std::vector<std::shared_ptr<Genome>> genomes() const;
+  // Range of population indices of the genomes in this species.
+  size_t begin() const;
+  size_t end() const;
 
   // Returns the number of organisms in the species.
   size_t size() const;
 
-  // Measures whether this species is compatible with a genome.
-  bool compatible(const Genome& genome) const;
-
-  // Creates a set of new genomes of the specified size by excluding
-  // lowest-performing genomes and breeding the survivors.
-  std::vector<std::shared_ptr<Genome>> reproduce(
-      const std::unordered_map<std::shared_ptr<Genome>, double>& fitnesses,
-      size_t size) const;
-
  private:
-  std::shared_ptr<Genome> representative_;
-  std::vector<std::shared_ptr<Genome>> genomes_;
+  size_t begin_;
+  size_t end_;
 };
 
 #endif
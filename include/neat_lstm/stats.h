@@ -0,0 +1,128 @@
+#ifndef NEAT_LSTM_STATS_H
+#define NEAT_LSTM_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Lightweight instrumentation of evolution: time spent in phases and counts of
+// operations, accumulated per thread without synchronization and summed on
+// demand. Recording goes through the STATS_TIMER and STATS_COUNT macros of
+// macros/stats.h, which compile to nothing unless NEAT_LSTM_STATS is defined.
+namespace stats {
+
+// Phases may nest: reproduction includes selection, mutation and the
+// speciation of the offspring. Phases run on worker threads, like mutation,
+// add up the time of all threads.
+enum Phase {
+  kEvaluation,
+  kSpeciation,
+  kReproduction,
+  // Planning the matings of species
+  kSelection,
+  kMutation,
+  kPhaseCount,
+};
+
+enum Counter {
+  // Compatibility measures between two genomes
+  kCompatibilityChecks,
+  kCrossovers,
+  // Nodes and connections added by mutations
+  kStructuralMutations,
+  // Networks compiled from genomes
+  kNetworksBuilt,
+  // Bytes of the arena blocks holding the genomes of new generations
+  kBytesAllocated,
+  // Worker processes that died and were replaced, see WorkerFleet
+  kWorkerRestarts,
+  kCounterCount,
+};
+
+const char* name(Phase phase);
+const char* name(Counter counter);
+
+// Returns whether recording is compiled in.
+bool enabled();
+
+// Phase times and counters of a generation.
+struct GenerationStats {
+  int generation = 0;
+  double phase_seconds[kPhaseCount] = {};
+  uint64_t counters[kCounterCount] = {};
+
+  // Names of the CSV columns, matching csv().
+  static std::string csv_header();
+  std::string csv() const;
+
+  // A single-line JSON object, e.g. for JSON Lines files.
+  std::string json() const;
+};
+
+// Produces the stats of consecutive generations as differences between the
+// totals of all threads at each call.
+class Recorder {
+ public:
+  // Starts from the current totals.
+  Recorder();
+
+  // Returns what was recorded since the previous call, or since construction.
+  GenerationStats next(int generation);
+
+ private:
+  GenerationStats totals_;
+};
+
+namespace internal {
+
+// Totals of a thread, written only by that thread and read by Recorder
+struct ThreadTotals {
+  std::atomic<uint64_t> phase_ns[kPhaseCount];
+  std::atomic<uint64_t> counters[kCounterCount];
+};
+
+// Allocates the totals of the calling thread. They outlive the thread.
+ThreadTotals* register_thread();
+
+inline ThreadTotals& local() {
+  thread_local ThreadTotals* totals = register_thread();
+  return *totals;
+}
+
+// Single-writer increment, cheaper than an atomic read-modify-write
+inline void add(std::atomic<uint64_t>& total, uint64_t value) {
+  total.store(total.load(std::memory_order_relaxed) + value,
+              std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+inline void count(Counter counter, uint64_t value) {
+  internal::add(internal::local().counters[counter], value);
+}
+
+// Adds the lifetime of the object to the time of a phase.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Phase phase)
+      : phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+  ~ScopedTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    internal::add(
+        internal::local().phase_ns[phase_],
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace stats
+
+#endif
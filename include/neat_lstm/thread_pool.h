@@ -0,0 +1,88 @@
+#ifndef NEAT_LSTM_THREAD_POOL_H
+#define NEAT_LSTM_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size pool of worker threads executing batches of indexed tasks.
+// Each worker owns a queue of tasks; it takes tasks from the front of its own
+// queue and, once that is empty, steals from the back of the others. Queues
+// keep their memory across batches, so run() does not allocate once the pool
+// has run a batch as large.
+class ThreadPool {
+ public:
+  // Load statistics of a worker, accumulated over all batches since the last
+  // reset_stats().
+  struct WorkerStats {
+    // Number of tasks executed
+    size_t tasks = 0;
+    // Number of those tasks that were stolen from another worker
+    size_t steals = 0;
+    // Time spent executing tasks
+    double busy_seconds = 0;
+  };
+
+  typedef std::function<void(size_t task, size_t worker)> Task;
+
+  // Creates a pool of the specified number of workers, or one per hardware
+  // thread if 0.
+  explicit ThreadPool(size_t size = 0);
+  ~ThreadPool();
+
+  size_t size() const;
+
+  // Runs task(index, worker) for every index in order and blocks until all
+  // have completed. Tasks are dealt round-robin to the workers in the given
+  // order, so expensive tasks should come first.
+  void run(const std::vector<size_t>& order, const Task& task);
+
+  // Runs task(index, worker) for every index in [0, count).
+  void parallel_for(size_t count, const Task& task);
+
+  const std::vector<WorkerStats>& stats() const;
+
+  // Fraction of the time spent in run() that the worker spent executing tasks.
+  double utilisation(size_t worker) const;
+
+  void reset_stats();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+ private:
+  // Tasks dealt to a worker, of which [front, back) are left
+  struct Queue {
+    std::mutex mutex;
+    std::vector<size_t> tasks;
+    size_t front = 0;
+    size_t back = 0;
+  };
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<WorkerStats> stats_;
+  double run_seconds_ = 0;
+
+  // State of the current batch
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const Task* task_ = nullptr;
+  size_t batch_ = 0;
+  size_t active_workers_ = 0;
+  bool stopping_ = false;
+
+  void work(size_t worker);
+
+  // Takes the next task of the worker, stealing if needed. Returns false if no
+  // tasks are left in any queue.
+  bool next_task(size_t worker, size_t& task, bool& stolen);
+};
+
+#endif
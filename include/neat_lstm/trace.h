@@ -0,0 +1,80 @@
+#ifndef NEAT_LSTM_TRACE_H
+#define NEAT_LSTM_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Records timelines of evolution as spans, and exports them in the Chrome
+// trace event format, viewable in Perfetto or chrome://tracing.
+// Each thread records into its own ring buffer, which keeps its most recent
+// spans, so recording takes no locks and a span costs two clock reads and a
+// few stores. Spans are recorded through the TRACE_SPAN macros of
+// macros/trace.h, which compile to nothing unless NEAT_LSTM_TRACE is defined,
+// and only while tracing is started.
+namespace trace {
+
+// Value of a span without an argument.
+const int64_t kNoArg = std::numeric_limits<int64_t>::min();
+
+// Starts recording, with ring buffers of capacity spans per thread. Previously
+// recorded spans are discarded. Each thread empties, or reallocates, its own
+// buffer when it next records, so start() may be called while other threads
+// record.
+void start(size_t capacity = 1 << 16);
+
+// Stops recording. Recorded spans are kept until the next start().
+void stop();
+
+inline bool enabled();
+
+// Writes the spans recorded so far as Chrome trace JSON. May be called while
+// recording, in which case spans recorded during the call may be left out.
+// Returns false if the file cannot be written.
+bool write(const std::string& path);
+
+namespace internal {
+
+extern std::atomic<bool> recording;
+
+// Records a complete span. name must have static storage duration.
+void record(const char* name, int64_t arg, uint64_t begin_ns,
+            uint64_t end_ns);
+
+uint64_t now_ns();
+
+}  // namespace internal
+
+inline bool enabled() {
+  return internal::recording.load(std::memory_order_relaxed);
+}
+
+// Records the lifetime of the object as a span, if tracing is started when it
+// is created.
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(const char* name, int64_t arg = kNoArg)
+      : name_(enabled() ? name : nullptr),
+        arg_(arg),
+        begin_ns_(name_ != nullptr ? internal::now_ns() : 0) {}
+
+  ~ScopedSpan() {
+    if (name_ != nullptr) {
+      internal::record(name_, arg_, begin_ns_, internal::now_ns());
+    }
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  const char* name_;
+  int64_t arg_;
+  uint64_t begin_ns_;
+};
+
+}  // namespace trace
+
+#endif
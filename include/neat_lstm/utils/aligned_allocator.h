@@ -0,0 +1,56 @@
+#ifndef NEAT_LSTM_UTILS_ALIGNED_ALLOCATOR_H
+#define NEAT_LSTM_UTILS_ALIGNED_ALLOCATOR_H
+
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace utils {
+
+// Allocator for memory aligned to the specified number of bytes, so that
+// buffers can be accessed with aligned SIMD loads. Defaults to the size of a
+// cache line, which also suits 512-bit vectors.
+template <typename T, size_t Alignment = 64>
+class AlignedAllocator {
+ public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+  T* allocate(size_t size) {
+    void* pointer = nullptr;
+    if (posix_memalign(&pointer, Alignment, size * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(pointer);
+  }
+
+  void deallocate(T* pointer, size_t) { free(pointer); }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&,
+                const AlignedAllocator<U, Alignment>&) {
+  return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&,
+                const AlignedAllocator<U, Alignment>&) {
+  return false;
+}
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+}  // namespace utils
+
+#endif
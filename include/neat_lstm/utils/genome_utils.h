@@ -1,10 +1,23 @@
 #ifndef NEAT_LSTM_UTILS_GENOME_UTILS_H
 #define NEAT_LSTM_UTILS_GENOME_UTILS_H
 
+#include <cstddef>
+#include <vector>
+
 #include "proto/structures.pb.h"
 
 namespace utils {
 
+// Connection genes of a genome flattened into arrays sorted by innovation
+// number, for measuring compatibility against many genomes.
+struct FlatConnections {
+  std::vector<int> innovations;
+  std::vector<double> weights;
+
+  FlatConnections() {}
+  explicit FlatConnections(const Genome& genome);
+};
+
 extern int genome_id;
 
 // Create a basic genome with the specified numbers of input and output nodes.
@@ -21,6 +34,19 @@ bool check_connections(const Genome& genome);
 // Measures how compatible 2 genomes are.
 // Takes into account connection genes and LSTM units.
 double compatibility(const Genome& a, const Genome& b);
+double compatibility(const FlatConnections& a, const FlatConnections& b);
+
+// Returns whether compatibility(a, b) < threshold. Stops early once the excess
+// and disjoint genes seen so far are enough to reach the threshold.
+bool compatible(const Genome& a, const Genome& b, double threshold);
+bool compatible(const FlatConnections& a, const FlatConnections& b,
+                double threshold);
+
+// Returns the index of the first representative in [begin, end) that the
+// genome is compatible with, or -1 if there is none.
+int first_compatible(const FlatConnections& genome,
+                     const std::vector<const FlatConnections*>& representatives,
+                     size_t begin, size_t end, double threshold);
 
 // Returns the type of a node with the specified id.
 // NOTE: This method relies on specific creation logic for genomes and results
@@ -9,7 +9,7 @@ namespace math {
 // Return a clamped value between min and max.
 template <typename T>
 T clamp(const T& value, const T& min, const T& max) {
-  return std::max(min, std::min(min, value));
+  return std::max(min, std::min(max, value));
 }
 
 }  // namespace math
@@ -1,15 +1,91 @@
 #ifndef NEAT_LSTM_UTILS_RANDOM_H
 #define NEAT_LSTM_UTILS_RANDOM_H
 
+#include <cstddef>
+#include <cstdint>
+
 namespace utils {
 namespace random {
 
-// Uniformly generate a random double in [start, end]
+// A counter-based Philox4x32-10 generator.
+// Every draw is a pure function of the run seed, the stream id and the index
+// of the draw, so streams can be created anywhere without shared state and
+// give the same numbers regardless of which thread uses them.
+class Stream {
+ public:
+  Stream(uint64_t seed, uint64_t generation, uint64_t id);
+
+  // Returns 64 random bits.
+  uint64_t next();
+
+  // Fills values with 64 random bits each. Gives the same values as calling
+  // next() size times.
+  void next(uint64_t* values, size_t size);
+
+  // Uniformly generate a random double in [start, end)
+  double uniform(double start, double end);
+
+  // Uniformly generate a random int in [start, end]
+  int uniform_int(int start, int end);
+
+  // Fills values with random doubles in [start, end)
+  void uniform(double* values, size_t size, double start, double end);
+
+ private:
+  uint32_t key_[2];
+  uint32_t counter_[4];
+  uint64_t buffer_[2];
+  int buffered_ = 0;
+
+  void refill();
+};
+
+// Sets the seed of the run. Streams are derived from it, and the calling
+// thread's default stream restarts from it.
+void seed(uint64_t seed);
+
+// Returns the seed of the run. Unless seed() is called, a random one is
+// chosen at startup.
+uint64_t seed();
+
+// Returns the stream of a genome or task of a generation.
+Stream stream(uint64_t generation, uint64_t id);
+
+// Directs the free functions below on the current thread to a stream derived
+// from the run seed for as long as the object lives. Scopes can be nested.
+class ScopedStream {
+ public:
+  ScopedStream(uint64_t generation, uint64_t id);
+  // Uses the generation of the enclosing scope, or 0 if there is none.
+  explicit ScopedStream(uint64_t id);
+  ~ScopedStream();
+
+  uint64_t generation() const;
+  Stream& stream();
+
+  ScopedStream(const ScopedStream&) = delete;
+  ScopedStream& operator=(const ScopedStream&) = delete;
+
+ private:
+  uint64_t generation_;
+  Stream stream_;
+  ScopedStream* previous_;
+};
+
+// Uniformly generate a random double in [start, end)
 double uniform(double start, double end);
 
 // Uniformly generate a random int in [start, end]
 int uniform_int(int start, int end);
 
+// Fills values with random doubles in [start, end). Cheaper than drawing the
+// values one by one.
+void uniform(double* values, size_t size, double start, double end);
+
+// Fills values with 64 random bits each. The top bit of each value is the
+// outcome uniform_int(0, 1) would have returned for the same draw.
+void next(uint64_t* values, size_t size);
+
 }  // namespace random
 }  // namespace utils
 
@@ -0,0 +1,42 @@
+#ifndef NEAT_LSTM_UTILS_RECORD_IO_H
+#define NEAT_LSTM_UTILS_RECORD_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() {}
+  ~MappedFile();
+
+  // Maps the file, replacing any previous mapping. Returns false if the file
+  // cannot be mapped or is empty, with the reason in error.
+  bool open(const std::string& path, std::string* error);
+
+  void close();
+
+  const uint8_t* data() const;
+  size_t size() const;
+
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Locates the length-delimited record (a varint byte size followed by the
+// message) at position of the data. Returns false if it does not fit.
+bool find_record(const uint8_t* data, size_t size, size_t position,
+                 size_t* start, size_t* length);
+
+}  // namespace utils
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef NEAT_LSTM_WORKER_FLEET_H
+#define NEAT_LSTM_WORKER_FLEET_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/population.h"
+#include "proto/structures.pb.h"
+
+// Evaluates genomes in local worker processes rather than threads, for
+// evaluators that are not thread-safe or that leak: a crash or leak only
+// affects its worker, which is replaced.
+// Workers are forked from the coordinating process, so each runs its own copy
+// of the evaluator as it was at the time of the fork. Memory mapped before,
+// such as a dataset in a utils::MappedFile, is shared read-only by all workers
+// instead of being copied.
+// Genomes are sent to each worker over a Unix domain socket in batches of
+// batch_size, and fitnesses come back one genome at a time (see
+// proto/worker.proto). Up to pipeline_depth batches are queued per worker, so
+// a worker moves on to its next batch without waiting for the coordinator.
+// When a worker dies, a new one is forked and the genomes the dead worker had
+// not finished are resubmitted. The genome it was evaluating is blamed; one
+// that takes down max_attempts workers gets failure_fitness instead.
+// A fleet is used from one thread at a time.
+class WorkerFleet {
+ public:
+  struct Options {
+    // Number of worker processes, or one per hardware thread if 0
+    size_t workers = 0;
+    size_t batch_size = 8;
+    size_t pipeline_depth = 2;
+    int max_attempts = 3;
+    double failure_fitness = 0;
+    // Genomes evaluated by a worker before it is replaced by a fresh one, to
+    // contain leaks, or 0 to keep workers for as long as they live
+    size_t genomes_per_worker = 0;
+  };
+
+  WorkerFleet(Evaluator& evaluator, const Options& options);
+  // Closes the sockets of the workers, on which they exit, and reaps them.
+  ~WorkerFleet();
+
+  // Forks the workers. Returns false if a worker cannot be started, with the
+  // reason in error().
+  bool start();
+
+  // Evaluates the genomes, writing the fitness of genomes[i] to
+  // fitnesses[i]. Genomes are dispatched in descending order of estimated
+  // cost. Returns false if a worker cannot be replaced, with the reason in
+  // error().
+  bool evaluate(const std::vector<Genome*>& genomes,
+                std::vector<double>* fitnesses);
+  // Evaluates all genomes of the population into its fitnesses.
+  bool evaluate(Population& population);
+
+  size_t size() const;
+  // Number of workers that died and were replaced, excluding those retired
+  // after genomes_per_worker genomes.
+  size_t restarts() const;
+
+  const std::string& error() const;
+
+  WorkerFleet(const WorkerFleet&) = delete;
+  WorkerFleet& operator=(const WorkerFleet&) = delete;
+
+ private:
+  // Tasks of a batch sent to a worker, of which the first done have results
+  struct Batch {
+    std::vector<size_t> tasks;
+    size_t done = 0;
+  };
+
+  struct Worker {
+    pid_t pid = -1;
+    // Coordinator's end of the socket, only used without blocking
+    int socket = -1;
+    // Bytes queued for the worker, from output_position on
+    std::string output;
+    size_t output_position = 0;
+    // Bytes received from the worker but not yet parsed
+    std::string input;
+    std::deque<Batch> batches;
+    // Genomes sent to the worker since it was started
+    size_t genomes_sent = 0;
+  };
+
+  Evaluator& evaluator_;
+  Options options_;
+  std::vector<Worker> workers_;
+  size_t restarts_ = 0;
+  std::string error_;
+
+  // State of the current evaluate()
+  const std::vector<Genome*>* genomes_ = nullptr;
+  std::vector<double>* fitnesses_ = nullptr;
+  std::deque<size_t> pending_;
+  std::vector<int> attempts_;
+  size_t remaining_ = 0;
+
+  // Forks a worker into the slot. Returns false on failure.
+  bool spawn(Worker& worker);
+  // Stops the worker and reaps its process.
+  void stop(Worker& worker);
+  // Replaces a dead worker, resubmitting or failing its unfinished tasks.
+  bool restart(Worker& worker);
+
+  // Queues batches for the worker while it has room and tasks are pending.
+  void dispatch(Worker& worker);
+  // Sends queued bytes until the socket is full. Returns false if the worker
+  // is gone.
+  bool flush(Worker& worker);
+  // Reads and applies the results available from the worker. Returns false if
+  // the worker is gone.
+  bool receive(Worker& worker);
+};
+
+#endif
@@ -1,25 +1,316 @@
+#include "neat_lstm/activation.h"
+
+#include <algorithm>
 #include <cmath>
-#include <unordered_map>
+#include <cstddef>
+#include <limits>
 
-#include "neat_lstm/activation.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "macros/assert.h"
+#include "proto/structures.pb.h"
 
 namespace activation {
+namespace {
+
+const double kSigmoidSlope = 4.9;
+const double kReluSlope = 0.0001;
+
+// tanh(x) is approximated by x * p(x^2) / q(x^2) on [-kTanhClamp, kTanhClamp],
+// and is within rounding of +-1 beyond. Coefficients are those of Eigen's fast
+// single precision tanh.
+const double kTanhClamp = 7.90531110763549805;
+const double kTanhP[] = {4.89352455891786e-03,  6.37261928875436e-04,
+                         1.48572235717979e-05,  5.12229709037114e-08,
+                         -8.60467152213735e-11, 2.00018790482477e-13,
+                         -2.76076847742355e-16};
+const double kTanhQ[] = {4.89352518554385e-03, 2.26843463243900e-03,
+                         1.18534705686654e-04, 1.19825839466702e-06};
+
+#if defined(__SSE2__)
+// The widest SIMD vector of Scalar the build targets
+template <typename Scalar>
+struct Vector;
+
+#if defined(__AVX512F__)
+template <>
+struct Vector<double> {
+  typedef __m512d Type;
+  static const size_t kWidth = 8;
+  static Type load(const double* p) { return _mm512_loadu_pd(p); }
+  static void store(double* p, Type v) { _mm512_storeu_pd(p, v); }
+  static Type set(double x) { return _mm512_set1_pd(x); }
+  static Type add(Type a, Type b) { return _mm512_add_pd(a, b); }
+  static Type mul(Type a, Type b) { return _mm512_mul_pd(a, b); }
+  static Type div(Type a, Type b) { return _mm512_div_pd(a, b); }
+  static Type min(Type a, Type b) { return _mm512_min_pd(a, b); }
+  static Type max(Type a, Type b) { return _mm512_max_pd(a, b); }
+};
+
+template <>
+struct Vector<float> {
+  typedef __m512 Type;
+  static const size_t kWidth = 16;
+  static Type load(const float* p) { return _mm512_loadu_ps(p); }
+  static void store(float* p, Type v) { _mm512_storeu_ps(p, v); }
+  static Type set(float x) { return _mm512_set1_ps(x); }
+  static Type add(Type a, Type b) { return _mm512_add_ps(a, b); }
+  static Type mul(Type a, Type b) { return _mm512_mul_ps(a, b); }
+  static Type div(Type a, Type b) { return _mm512_div_ps(a, b); }
+  static Type min(Type a, Type b) { return _mm512_min_ps(a, b); }
+  static Type max(Type a, Type b) { return _mm512_max_ps(a, b); }
+};
+#elif defined(__AVX2__)
+template <>
+struct Vector<double> {
+  typedef __m256d Type;
+  static const size_t kWidth = 4;
+  static Type load(const double* p) { return _mm256_loadu_pd(p); }
+  static void store(double* p, Type v) { _mm256_storeu_pd(p, v); }
+  static Type set(double x) { return _mm256_set1_pd(x); }
+  static Type add(Type a, Type b) { return _mm256_add_pd(a, b); }
+  static Type mul(Type a, Type b) { return _mm256_mul_pd(a, b); }
+  static Type div(Type a, Type b) { return _mm256_div_pd(a, b); }
+  static Type min(Type a, Type b) { return _mm256_min_pd(a, b); }
+  static Type max(Type a, Type b) { return _mm256_max_pd(a, b); }
+};
+
+template <>
+struct Vector<float> {
+  typedef __m256 Type;
+  static const size_t kWidth = 8;
+  static Type load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, Type v) { _mm256_storeu_ps(p, v); }
+  static Type set(float x) { return _mm256_set1_ps(x); }
+  static Type add(Type a, Type b) { return _mm256_add_ps(a, b); }
+  static Type mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+  static Type div(Type a, Type b) { return _mm256_div_ps(a, b); }
+  static Type min(Type a, Type b) { return _mm256_min_ps(a, b); }
+  static Type max(Type a, Type b) { return _mm256_max_ps(a, b); }
+};
+#else
+template <>
+struct Vector<double> {
+  typedef __m128d Type;
+  static const size_t kWidth = 2;
+  static Type load(const double* p) { return _mm_loadu_pd(p); }
+  static void store(double* p, Type v) { _mm_storeu_pd(p, v); }
+  static Type set(double x) { return _mm_set1_pd(x); }
+  static Type add(Type a, Type b) { return _mm_add_pd(a, b); }
+  static Type mul(Type a, Type b) { return _mm_mul_pd(a, b); }
+  static Type div(Type a, Type b) { return _mm_div_pd(a, b); }
+  static Type min(Type a, Type b) { return _mm_min_pd(a, b); }
+  static Type max(Type a, Type b) { return _mm_max_pd(a, b); }
+};
+
+template <>
+struct Vector<float> {
+  typedef __m128 Type;
+  static const size_t kWidth = 4;
+  static Type load(const float* p) { return _mm_loadu_ps(p); }
+  static void store(float* p, Type v) { _mm_storeu_ps(p, v); }
+  static Type set(float x) { return _mm_set1_ps(x); }
+  static Type add(Type a, Type b) { return _mm_add_ps(a, b); }
+  static Type mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+  static Type div(Type a, Type b) { return _mm_div_ps(a, b); }
+  static Type min(Type a, Type b) { return _mm_min_ps(a, b); }
+  static Type max(Type a, Type b) { return _mm_max_ps(a, b); }
+};
+#endif
+
+// Vector versions of fast_tanh(), fast_sigmoid() and relu(), with the same
+// order of operations
+template <typename Scalar>
+typename Vector<Scalar>::Type vector_tanh(typename Vector<Scalar>::Type x) {
+  typedef Vector<Scalar> V;
+  x = V::min(V::max(x, V::set(-kTanhClamp)), V::set(kTanhClamp));
+  typename V::Type x2 = V::mul(x, x);
+  typename V::Type p = V::set(kTanhP[6]);
+  for (int i = 5; i >= 0; i--) {
+    p = V::add(V::mul(p, x2), V::set(kTanhP[i]));
+  }
+  typename V::Type q = V::set(kTanhQ[3]);
+  for (int i = 2; i >= 0; i--) {
+    q = V::add(V::mul(q, x2), V::set(kTanhQ[i]));
+  }
+  return V::div(V::mul(x, p), q);
+}
+
+template <typename Scalar>
+typename Vector<Scalar>::Type vector_sigmoid(typename Vector<Scalar>::Type x) {
+  typedef Vector<Scalar> V;
+  typename V::Type t =
+      vector_tanh<Scalar>(V::mul(x, V::set(kSigmoidSlope / 2)));
+  return V::add(V::mul(t, V::set(0.5)), V::set(0.5));
+}
+
+template <typename Scalar>
+typename Vector<Scalar>::Type vector_relu(typename Vector<Scalar>::Type x) {
+  typedef Vector<Scalar> V;
+  typename V::Type zero = V::set(0);
+  return V::add(V::max(x, zero), V::mul(V::min(x, zero), V::set(kReluSlope)));
+}
+#endif
+
+}  // namespace
 
-double sigmoid(double x) { return 1 / (1 + exp(-4.9 * x)); }
+template <typename Scalar>
+Scalar sigmoid(Scalar x) {
+  return 1 / (1 + std::exp(Scalar(-kSigmoidSlope) * x));
+}
 
-double tanh(double x) { return std::tanh(x); }
+template <typename Scalar>
+Scalar tanh(Scalar x) {
+  return std::tanh(x);
+}
 
-double relu(double x) {
-  double g = 0.0001;
+template <typename Scalar>
+Scalar relu(Scalar x) {
+  Scalar g = kReluSlope;
 
   return x > 0 ? x : g * x;
 }
 
-const std::unordered_map<ActivationType, activation_t*>& get_activation_map() {
-  static const std::unordered_map<ActivationType, activation_t*>
-      activation_map = {{SIGMOID, sigmoid}, {RELU, relu}, {TANH, tanh}};
+template <typename Scalar>
+Scalar fast_sigmoid(Scalar x) {
+  return fast_tanh(x * Scalar(kSigmoidSlope / 2)) * Scalar(0.5) + Scalar(0.5);
+}
+
+template <typename Scalar>
+Scalar fast_tanh(Scalar x) {
+  const Scalar clamp = kTanhClamp;
+  x = std::min(std::max(x, -clamp), clamp);
+  Scalar x2 = x * x;
+  Scalar p = kTanhP[6];
+  for (int i = 5; i >= 0; i--) {
+    p = p * x2 + Scalar(kTanhP[i]);
+  }
+  Scalar q = kTanhQ[3];
+  for (int i = 2; i >= 0; i--) {
+    q = q * x2 + Scalar(kTanhQ[i]);
+  }
+  return x * p / q;
+}
+
+template <typename Scalar>
+void sigmoid(const Scalar* inputs, Scalar* outputs, size_t size, Mode mode) {
+  if (mode == Mode::kExact) {
+    for (size_t i = 0; i < size; i++) {
+      outputs[i] = sigmoid(inputs[i]);
+    }
+    return;
+  }
+  size_t i = 0;
+#if defined(__SSE2__)
+  typedef Vector<Scalar> V;
+  for (; i + V::kWidth <= size; i += V::kWidth) {
+    V::store(outputs + i, vector_sigmoid<Scalar>(V::load(inputs + i)));
+  }
+#endif
+  for (; i < size; i++) {
+    outputs[i] = fast_sigmoid(inputs[i]);
+  }
+}
+
+template <typename Scalar>
+void tanh(const Scalar* inputs, Scalar* outputs, size_t size, Mode mode) {
+  if (mode == Mode::kExact) {
+    for (size_t i = 0; i < size; i++) {
+      outputs[i] = tanh(inputs[i]);
+    }
+    return;
+  }
+  size_t i = 0;
+#if defined(__SSE2__)
+  typedef Vector<Scalar> V;
+  for (; i + V::kWidth <= size; i += V::kWidth) {
+    V::store(outputs + i, vector_tanh<Scalar>(V::load(inputs + i)));
+  }
+#endif
+  for (; i < size; i++) {
+    outputs[i] = fast_tanh(inputs[i]);
+  }
+}
+
+template <typename Scalar>
+void relu(const Scalar* inputs, Scalar* outputs, size_t size) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  typedef Vector<Scalar> V;
+  for (; i + V::kWidth <= size; i += V::kWidth) {
+    V::store(outputs + i, vector_relu<Scalar>(V::load(inputs + i)));
+  }
+#endif
+  for (; i < size; i++) {
+    outputs[i] = relu(inputs[i]);
+  }
+}
 
-  return activation_map;
+bool is_defined(ActivationType type) {
+  switch (type) {
+    case SIGMOID:
+    case TANH:
+    case RELU:
+      return true;
+    default:
+      return false;
+  }
 }
 
+template <typename Scalar>
+Scalar activate(ActivationType type, Scalar x, Mode mode) {
+  switch (type) {
+    case SIGMOID:
+      return mode == Mode::kFast ? fast_sigmoid(x) : sigmoid(x);
+    case TANH:
+      return mode == Mode::kFast ? fast_tanh(x) : tanh(x);
+    case RELU:
+      return relu(x);
+    default:
+      ASSERT(false, "Activation type: %d\n", type);
+      return std::numeric_limits<Scalar>::quiet_NaN();
+  }
+}
+
+template <typename Scalar>
+void activate(ActivationType type, const Scalar* inputs, Scalar* outputs,
+              size_t size, Mode mode) {
+  switch (type) {
+    case SIGMOID:
+      sigmoid(inputs, outputs, size, mode);
+      break;
+    case TANH:
+      tanh(inputs, outputs, size, mode);
+      break;
+    case RELU:
+      relu(inputs, outputs, size);
+      break;
+    default:
+      ASSERT(false, "Activation type: %d\n", type);
+      std::fill_n(outputs, size, std::numeric_limits<Scalar>::quiet_NaN());
+  }
+}
+
+#define INSTANTIATE(Scalar)                                                  \
+  template Scalar sigmoid(Scalar x);                                         \
+  template Scalar tanh(Scalar x);                                            \
+  template Scalar relu(Scalar x);                                            \
+  template Scalar fast_sigmoid(Scalar x);                                    \
+  template Scalar fast_tanh(Scalar x);                                       \
+  template void sigmoid(const Scalar* inputs, Scalar* outputs, size_t size,  \
+                        Mode mode);                                          \
+  template void tanh(const Scalar* inputs, Scalar* outputs, size_t size,     \
+                     Mode mode);                                             \
+  template void relu(const Scalar* inputs, Scalar* outputs, size_t size);    \
+  template Scalar activate(ActivationType type, Scalar x, Mode mode);        \
+  template void activate(ActivationType type, const Scalar* inputs,          \
+                         Scalar* outputs, size_t size, Mode mode);
+
+INSTANTIATE(float)
+INSTANTIATE(double)
+
+#undef INSTANTIATE
+
 }  // namespace activation
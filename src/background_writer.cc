@@ -0,0 +1,61 @@
+#include "neat_lstm/background_writer.h"
+
+#include <mutex>
+#include <string>
+#include <utility>
+
+BackgroundWriter::BackgroundWriter()
+    : thread_(&BackgroundWriter::run, this) {}
+
+BackgroundWriter::~BackgroundWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queued_.notify_all();
+  thread_.join();
+}
+
+void BackgroundWriter::submit(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  queued_.notify_one();
+}
+
+bool BackgroundWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this]() { return tasks_.empty() && !running_; });
+  bool succeeded = !failed_;
+  failed_ = false;
+  return succeeded;
+}
+
+const std::string& BackgroundWriter::error() const { return error_; }
+
+void BackgroundWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      return;
+    }
+    Task task = std::move(tasks_.front());
+    tasks_.pop_front();
+    running_ = true;
+    lock.unlock();
+
+    std::string error = task();
+    // Release what the task holds, e.g. genomes' arenas, outside of the lock
+    task = nullptr;
+
+    lock.lock();
+    running_ = false;
+    if (!error.empty()) {
+      failed_ = true;
+      error_ = error;
+    }
+    done_.notify_all();
+  }
+}
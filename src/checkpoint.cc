@@ -0,0 +1,189 @@
+#include "neat_lstm/checkpoint.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/genome_utils.h"
+#include "neat_lstm/utils/random.h"
+#include "neat_lstm/utils/record_io.h"
+#include "proto/checkpoint.pb.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Version 1 checkpoints were taken before evaluation, with zero fitnesses
+const uint32_t kVersion = 2;
+
+}  // namespace
+
+void CheckpointWriter::write(const Population& population,
+                             const std::string& path) {
+  std::shared_ptr<Job> job(new Job{population, CheckpointHeader(), path});
+  CheckpointHeader& header = job->header;
+  header.set_version(kVersion);
+  header.set_seed(utils::random::seed());
+  header.set_generation(population.generation());
+  header.set_next_genome_id(utils::genome_id);
+
+  const InnovationRegistry& registry = Innovation::registry();
+  for (const auto& entry : registry.entries()) {
+    auto* innovation = header.add_innovations();
+    innovation->set_in_node(entry.in_node_id);
+    innovation->set_out_node(entry.out_node_id);
+    innovation->set_innovation(entry.innovation);
+  }
+  header.set_max_innovation(registry.get_max());
+
+  for (const auto& species : population.species()) {
+    header.add_species_ends(species.end());
+  }
+  if (population.fitnesses_.size() == population.genomes_.size()) {
+    header.mutable_fitnesses()->Add(population.fitnesses_.begin(),
+                                    population.fitnesses_.end());
+  }
+
+  writer_.submit([job]() { return save(*job); });
+}
+
+bool CheckpointWriter::flush() { return writer_.flush(); }
+
+const std::string& CheckpointWriter::error() const { return writer_.error(); }
+
+std::string CheckpointWriter::save(Job& job) {
+  using google::protobuf::io::CodedOutputStream;
+  const auto& genomes = job.population.genomes_;
+  CheckpointHeader& header = job.header;
+
+  // Computing sizes up front gives the offsets of the records, and caches the
+  // sizes for serialization
+  uint64_t offset = 0;
+  header.mutable_genome_offsets()->Reserve(genomes.size());
+  for (const Genome* genome : genomes) {
+    header.add_genome_offsets(offset);
+    size_t size = genome->ByteSizeLong();
+    offset += CodedOutputStream::VarintSize64(size) + size;
+  }
+
+  const std::string temporary = job.path + ".tmp";
+  std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    return "Cannot open " + temporary + ": " + std::strerror(errno);
+  }
+  {
+    google::protobuf::io::OstreamOutputStream stream(&output);
+    CodedOutputStream coded(&stream);
+    coded.WriteVarint64(header.ByteSizeLong());
+    header.SerializeWithCachedSizes(&coded);
+    for (const Genome* genome : genomes) {
+      coded.WriteVarint64(genome->GetCachedSize());
+      genome->SerializeWithCachedSizes(&coded);
+    }
+    if (coded.HadError()) {
+      return "Cannot write " + temporary;
+    }
+  }
+  output.close();
+  if (!output) {
+    return "Cannot write " + temporary;
+  }
+
+  if (std::rename(temporary.c_str(), job.path.c_str()) != 0) {
+    return "Cannot rename " + temporary + ": " + std::strerror(errno);
+  }
+  return "";
+}
+
+bool CheckpointReader::open(const std::string& path) {
+  close();
+  if (!file_.open(path, &error_)) {
+    return false;
+  }
+  const uint8_t* data = file_.data();
+  const size_t size = file_.size();
+
+  size_t start;
+  size_t length;
+  if (!utils::find_record(data, size, 0, &start, &length) ||
+      !header_.ParseFromArray(data + start, length)) {
+    error_ = "Corrupt checkpoint header in " + path;
+    close();
+    return false;
+  }
+  if (header_.version() != kVersion) {
+    error_ = "Unsupported checkpoint version " +
+             std::to_string(header_.version()) + " in " + path;
+    close();
+    return false;
+  }
+  records_ = start + length;
+
+  // Genomes are parsed lazily, but their layout is checked now
+  const auto& offsets = header_.genome_offsets();
+  const auto& species_ends = header_.species_ends();
+  bool valid =
+      (header_.fitnesses_size() == 0 ||
+       header_.fitnesses_size() == offsets.size()) &&
+      (offsets.empty() ? species_ends.empty()
+                       : !species_ends.empty() &&
+                             species_ends.Get(species_ends.size() - 1) ==
+                                 (uint64_t)offsets.size());
+  for (int i = 0; valid && i < offsets.size(); i++) {
+    valid = offsets.Get(i) < size - records_ &&
+            (i == 0 || offsets.Get(i - 1) < offsets.Get(i));
+  }
+  for (int i = 1; valid && i < species_ends.size(); i++) {
+    valid = species_ends.Get(i - 1) < species_ends.Get(i);
+  }
+  if (!valid) {
+    error_ = "Corrupt checkpoint layout in " + path;
+    close();
+    return false;
+  }
+  return true;
+}
+
+const CheckpointHeader& CheckpointReader::header() const { return header_; }
+
+size_t CheckpointReader::genome_count() const {
+  return header_.genome_offsets_size();
+}
+
+bool CheckpointReader::genome(size_t index, Genome* genome) const {
+  size_t start;
+  size_t length;
+  return index < genome_count() &&
+         utils::find_record(file_.data(), file_.size(),
+                            records_ + header_.genome_offsets(index), &start,
+                            &length) &&
+         genome->ParseFromArray(file_.data() + start, length);
+}
+
+void CheckpointReader::restore_globals() const {
+  utils::random::seed(header_.seed());
+  utils::genome_id = header_.next_genome_id();
+
+  std::vector<InnovationRegistry::Entry> entries;
+  entries.reserve(header_.innovations_size());
+  for (const auto& innovation : header_.innovations()) {
+    entries.push_back({innovation.in_node(), innovation.out_node(),
+                       innovation.innovation()});
+  }
+  Innovation::registry().restore(entries, header_.max_innovation());
+}
+
+const std::string& CheckpointReader::error() const { return error_; }
+
+void CheckpointReader::close() {
+  file_.close();
+  records_ = 0;
+  header_.Clear();
+}
@@ -0,0 +1,391 @@
+#include "neat_lstm/compiled_network.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "macros/assert.h"
+#include "macros/stats.h"
+#include "neat_lstm/activation.h"
+#include "neat_lstm/genome_delta.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Number of samples evaluated together by activate_batch(). Large enough to
+// amortize per-node overhead, small enough for the node rows to stay in cache.
+const size_t kBatchTile = 128;
+
+// Slot of a connection that does not affect activations (disabled, or a bias
+// connection overridden by a later one)
+const int kUnusedSlot = -1;
+
+// Slots below kUnusedSlot encode the index of a bias in biases_
+int bias_slot(int bias) { return kUnusedSlot - 1 - bias; }
+int bias_index(int slot) { return kUnusedSlot - 1 - slot; }
+
+// Accumulates weight * source into sums over a row of samples.
+template <typename Scalar>
+void multiply_add(Scalar* __restrict sums, const Scalar* __restrict source,
+                  Scalar weight, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    sums[i] += source[i] * weight;
+  }
+}
+
+}  // namespace
+
+template <typename Scalar>
+CompiledNetwork<Scalar>::CompiledNetwork() : mode_(activation::Mode::kExact) {
+  edge_offsets_.push_back(0);
+}
+
+template <typename Scalar>
+CompiledNetwork<Scalar>::CompiledNetwork(const Genome& genome,
+                                         activation::Mode mode) {
+  rebuild(genome, mode);
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::rebuild(const Genome& genome,
+                                      activation::Mode mode) {
+  STATS_COUNT(stats::kNetworksBuilt, 1);
+  mode_ = mode;
+  input_indices_.clear();
+  output_indices_.clear();
+  bias_indices_.clear();
+  lstm_out_offsets_.clear();
+  lstm_out_indices_.clear();
+  computed_nodes_.clear();
+  activation_types_.clear();
+  biases_.clear();
+  edge_offsets_.clear();
+  edge_sources_.clear();
+  edge_weights_.clear();
+
+  // Assign dense indices in topological order. Node ids are small and dense
+  // within a genome, so they index a flat table.
+  int max_id = -1;
+  for (const Node& node : genome.nodes()) {
+    max_id = std::max(max_id, node.id());
+  }
+  node_indices_.assign(max_id + 1, -1);
+  activations_.assign(genome.nodes_size(), 0);
+  for (int i = 0; i < genome.nodes_size(); i++) {
+    const Node& node = genome.nodes(i);
+    node_indices_.at(node.id()) = i;
+    switch (node.type()) {
+      case Node::INPUT: {
+        input_indices_.push_back(i);
+        break;
+      }
+      case Node::OUTPUT: {
+        output_indices_.push_back(i);
+        break;
+      }
+      case Node::BIAS: {
+        bias_indices_.push_back(i);
+        activations_.at(i) = 1;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // Kernels of units beyond those of the genome are kept as spares
+  while ((int)lstm_kernels_.size() > genome.lstm_units_size()) {
+    spare_kernels_.push_back(std::move(lstm_kernels_.back()));
+    lstm_kernels_.pop_back();
+  }
+  lstm_out_offsets_.push_back(0);
+  for (int u = 0; u < genome.lstm_units_size(); u++) {
+    const LSTMUnit& lstm_unit = genome.lstm_units(u);
+    if (u < (int)lstm_kernels_.size()) {
+      lstm_kernels_[u].rebuild(lstm_unit, input_indices_.size(), mode_);
+    } else if (!spare_kernels_.empty()) {
+      lstm_kernels_.push_back(std::move(spare_kernels_.back()));
+      spare_kernels_.pop_back();
+      lstm_kernels_.back().rebuild(lstm_unit, input_indices_.size(), mode_);
+    } else {
+      lstm_kernels_.emplace_back(lstm_unit, input_indices_.size(), mode_);
+    }
+    for (int out_node : lstm_unit.out_nodes()) {
+      lstm_out_indices_.push_back(node_index(out_node));
+    }
+    lstm_out_offsets_.push_back(lstm_out_indices_.size());
+  }
+
+  // Bucket enabled connection positions by target with a counting sort,
+  // keeping the order of the genome. Connections of node i are stored in
+  // [in_offsets_[i], in_offsets_[i + 1]).
+  has_connections_.assign(genome.nodes_size(), false);
+  in_offsets_.assign(genome.nodes_size() + 1, 0);
+  for (const Connection& connection : genome.connections()) {
+    int index = node_index(connection.out_node());
+    has_connections_[index] = true;
+    in_offsets_[index + 1] += connection.enabled();
+  }
+  std::partial_sum(in_offsets_.begin(), in_offsets_.end(),
+                   in_offsets_.begin());
+  in_cursors_.assign(in_offsets_.begin(), in_offsets_.end() - 1);
+  in_connections_.resize(in_offsets_.back());
+  for (int c = 0; c < genome.connections_size(); c++) {
+    const Connection& connection = genome.connections(c);
+    if (connection.enabled()) {
+      int index = node_index(connection.out_node());
+      in_connections_[in_cursors_[index]++] = c;
+    }
+  }
+  connection_slots_.assign(genome.connections_size(), kUnusedSlot);
+
+  edge_offsets_.push_back(0);
+  for (int i = genome.input_size() + 1; i < genome.nodes_size(); i++) {
+    if (!has_connections_[i]) {
+      continue;
+    }
+
+    const Node& node = genome.nodes(i);
+    ASSERT(activation::is_defined(node.activation_type()),
+           "Index %d, Node type: %d, Activation type: %d\n", i, node.type(),
+           node.activation_type());
+
+    // Only the last bias connection contributes, as in Network
+    double bias = 0;
+    int bias_connection = -1;
+    for (int k = in_offsets_[i]; k < in_offsets_[i + 1]; k++) {
+      int c = in_connections_[k];
+      const Connection& connection = genome.connections(c);
+      int source = node_index(connection.in_node());
+      if (genome.nodes(source).type() == Node::BIAS) {
+        bias = connection.weight() * activations_.at(source);
+        bias_connection = c;
+        continue;
+      }
+      connection_slots_.at(c) = edge_weights_.size();
+      edge_sources_.push_back(source);
+      edge_weights_.push_back(connection.weight());
+    }
+    if (bias_connection >= 0) {
+      connection_slots_.at(bias_connection) = bias_slot(biases_.size());
+    }
+
+    computed_nodes_.push_back(i);
+    activation_types_.push_back(node.activation_type());
+    biases_.push_back(bias);
+    edge_offsets_.push_back(edge_sources_.size());
+  }
+}
+
+template <typename Scalar>
+bool CompiledNetwork<Scalar>::update(const Genome& genome,
+                                     const GenomeDelta& delta) {
+  if (!delta.weights_only() ||
+      genome.connections_size() != (int)connection_slots_.size()) {
+    rebuild(genome, mode_);
+    return false;
+  }
+
+  for (int c : delta.weights()) {
+    int slot = connection_slots_[c];
+    double weight = genome.connections(c).weight();
+    if (slot >= 0) {
+      edge_weights_[slot] = weight;
+    } else if (slot != kUnusedSlot) {
+      // Bias nodes have an activation of 1
+      biases_[bias_index(slot)] = weight;
+    }
+  }
+  return true;
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::activate(const std::vector<double>& inputs) {
+  // Input size must match genome schema
+  assert(inputs.size() == input_indices_.size());
+  for (size_t i = 0; i < input_indices_.size(); i++) {
+    activations_[input_indices_[i]] = inputs[i];
+  }
+  propagate();
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::activate(const Scalar* inputs) {
+  for (size_t i = 0; i < input_indices_.size(); i++) {
+    activations_[input_indices_[i]] = inputs[i];
+  }
+  propagate();
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::propagate() {
+  // Activate LSTM units and propagate to connected hidden nodes
+  for (size_t u = 0; u < lstm_kernels_.size(); u++) {
+    LSTMKernel<Scalar>& kernel = lstm_kernels_[u];
+    Scalar* kernel_inputs = kernel.inputs();
+    for (size_t i = 0; i < input_indices_.size(); i++) {
+      kernel_inputs[i] = activations_[input_indices_[i]];
+    }
+    kernel.step();
+    for (int i = lstm_out_offsets_[u]; i < lstm_out_offsets_[u + 1]; i++) {
+      activations_[lstm_out_indices_[i]] =
+          kernel.activations()[i - lstm_out_offsets_[u]];
+    }
+  }
+
+  for (size_t k = 0; k < computed_nodes_.size(); k++) {
+    Scalar weighted_sum = 0;
+    for (int e = edge_offsets_[k]; e < edge_offsets_[k + 1]; e++) {
+      weighted_sum += activations_[edge_sources_[e]] * edge_weights_[e];
+    }
+    activations_[computed_nodes_[k]] = activation::activate(
+        activation_types_[k], weighted_sum + biases_[k], mode_);
+  }
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::activate_batch(const Scalar* inputs,
+                                             size_t batch_size,
+                                             Scalar* outputs) {
+  ASSERT(lstm_kernels_.empty(), "LSTM units: %zu\n", lstm_kernels_.size());
+  const size_t input_size = input_indices_.size();
+  const size_t output_size = output_indices_.size();
+  batch_activations_.resize(activations_.size() * kBatchTile);
+
+  for (size_t start = 0; start < batch_size; start += kBatchTile) {
+    const size_t tile = std::min(kBatchTile, batch_size - start);
+
+    // Nodes that are never recalculated keep their current activation
+    for (size_t n = 0; n < activations_.size(); n++) {
+      std::fill_n(&batch_activations_[n * kBatchTile], tile, activations_[n]);
+    }
+
+    // Transpose inputs into node rows
+    for (size_t i = 0; i < input_size; i++) {
+      Scalar* row = &batch_activations_[input_indices_[i] * kBatchTile];
+      for (size_t b = 0; b < tile; b++) {
+        row[b] = inputs[(start + b) * input_size + i];
+      }
+    }
+
+    for (size_t k = 0; k < computed_nodes_.size(); k++) {
+      Scalar* sums = &batch_activations_[computed_nodes_[k] * kBatchTile];
+      std::fill_n(sums, tile, 0);
+      for (int e = edge_offsets_[k]; e < edge_offsets_[k + 1]; e++) {
+        multiply_add(sums, &batch_activations_[edge_sources_[e] * kBatchTile],
+                     edge_weights_[e], tile);
+      }
+      for (size_t b = 0; b < tile; b++) {
+        sums[b] += biases_[k];
+      }
+      activation::activate(activation_types_[k], sums, sums, tile, mode_);
+    }
+
+    // Transpose output node rows back into samples
+    for (size_t o = 0; o < output_size; o++) {
+      const Scalar* row = &batch_activations_[output_indices_[o] * kBatchTile];
+      for (size_t b = 0; b < tile; b++) {
+        outputs[(start + b) * output_size + o] = row[b];
+      }
+    }
+  }
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::activate_sequence(const Scalar* inputs,
+                                                size_t length,
+                                                Scalar* outputs) {
+  const size_t input_size = input_indices_.size();
+  const size_t output_size = output_indices_.size();
+  for (size_t t = 0; t < length; t++) {
+    activate(inputs + t * input_size);
+    activations(outputs + t * output_size);
+  }
+}
+
+template <typename Scalar>
+size_t CompiledNetwork<Scalar>::state_size() const {
+  size_t size = activations_.size();
+  for (const auto& kernel : lstm_kernels_) {
+    size += kernel.state_size();
+  }
+  return size;
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::reset_state() {
+  std::fill(activations_.begin(), activations_.end(), 0);
+  for (int i : bias_indices_) {
+    activations_[i] = 1;
+  }
+  for (auto& kernel : lstm_kernels_) {
+    kernel.reset();
+  }
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::save_state(Scalar* state) const {
+  state = std::copy(activations_.begin(), activations_.end(), state);
+  for (const auto& kernel : lstm_kernels_) {
+    kernel.save_state(state);
+    state += kernel.state_size();
+  }
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::restore_state(const Scalar* state) {
+  std::copy_n(state, activations_.size(), activations_.begin());
+  state += activations_.size();
+  for (auto& kernel : lstm_kernels_) {
+    kernel.restore_state(state);
+    state += kernel.state_size();
+  }
+}
+
+template <typename Scalar>
+std::vector<double> CompiledNetwork<Scalar>::activations() const {
+  std::vector<double> activations(output_indices_.size());
+  for (size_t i = 0; i < output_indices_.size(); i++) {
+    activations[i] = activations_[output_indices_[i]];
+  }
+  return activations;
+}
+
+template <typename Scalar>
+void CompiledNetwork<Scalar>::activations(Scalar* outputs) const {
+  for (size_t i = 0; i < output_indices_.size(); i++) {
+    outputs[i] = activations_[output_indices_[i]];
+  }
+}
+
+template <typename Scalar>
+int CompiledNetwork<Scalar>::node_index(int id) const {
+  int index = node_indices_.at(id);
+  ASSERT(index >= 0, "Unknown node id: %d\n", id);
+  return index;
+}
+
+template <typename Scalar>
+int CompiledNetwork<Scalar>::input_size() const {
+  return input_indices_.size();
+}
+
+template <typename Scalar>
+int CompiledNetwork<Scalar>::output_size() const {
+  return output_indices_.size();
+}
+
+template <typename Scalar>
+int CompiledNetwork<Scalar>::node_count() const {
+  return activations_.size();
+}
+
+template <typename Scalar>
+int CompiledNetwork<Scalar>::edge_count() const {
+  return edge_sources_.size();
+}
+
+template class CompiledNetwork<float>;
+template class CompiledNetwork<double>;
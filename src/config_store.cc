@@ -14,4 +14,16 @@ const Config_Bounds& ConfigStore::bounds() {
   return get().config_.bounds();
 }
 
+const Config_Reproduction& ConfigStore::reproduction() {
+  return get().config_.reproduction();
+}
+
+const Config_Evaluation& ConfigStore::evaluation() {
+  return get().config_.evaluation();
+}
+
+const Config_Islands& ConfigStore::islands() {
+  return get().config_.islands();
+}
+
 void ConfigStore::set(const Config& config) { config_ = config; }
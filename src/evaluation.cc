@@ -0,0 +1,80 @@
+#include "neat_lstm/evaluation.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "macros/stats.h"
+#include "macros/trace.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Buffers of evaluate() on a pool, kept across generations
+struct Schedule {
+  std::vector<double> costs;
+  std::vector<size_t> order;
+};
+
+Schedule& local_schedule() {
+  static thread_local Schedule schedule;
+  return schedule;
+}
+
+}  // namespace
+
+double Evaluator::cost(const Genome& genome) const {
+  double operations = 0;
+  for (const auto& connection : genome.connections()) {
+    operations += connection.enabled();
+  }
+  for (const auto& lstm_unit : genome.lstm_units()) {
+    // Four gates of capacity * (capacity + input_size) weights
+    operations += 4.0 * lstm_unit.capacity() *
+                  (lstm_unit.capacity() + genome.input_size());
+  }
+  return std::max(operations, 1.0) * sequence_length();
+}
+
+void evaluate(Population& population, Evaluator& evaluator, ThreadPool& pool) {
+  STATS_TIMER(stats::kEvaluation);
+  TRACE_SPAN("evaluate");
+  const auto& genomes = population.genomes_;
+
+  Schedule& schedule = local_schedule();
+  auto& costs = schedule.costs;
+  costs.resize(genomes.size());
+  for (size_t i = 0; i < genomes.size(); i++) {
+    costs.at(i) = evaluator.cost(*genomes.at(i));
+  }
+  // Ties are broken by index, which gives the order of a stable sort without
+  // its temporary buffer
+  auto& order = schedule.order;
+  order.resize(genomes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+    return costs.at(a) > costs.at(b) || (costs.at(a) == costs.at(b) && a < b);
+  });
+
+  // Each task writes its own slot, so no synchronization is needed. The task
+  // captures no more than std::function stores without allocating.
+  population.fitnesses_.resize(genomes.size());
+  pool.run(order, [&population, &evaluator](size_t index, size_t /*worker*/) {
+    const Genome& genome = *population.genomes_.at(index);
+    TRACE_SPAN("evaluate_genome", genome.id());
+    population.fitnesses_.at(index) = evaluator.evaluate(genome);
+  });
+}
+
+void evaluate(Population& population, Evaluator& evaluator) {
+  STATS_TIMER(stats::kEvaluation);
+  TRACE_SPAN("evaluate");
+  const auto& genomes = population.genomes_;
+  population.fitnesses_.resize(genomes.size());
+  for (size_t i = 0; i < genomes.size(); i++) {
+    TRACE_SPAN("evaluate_genome", genomes.at(i)->id());
+    population.fitnesses_.at(i) = evaluator.evaluate(*genomes.at(i));
+  }
+}
@@ -0,0 +1,87 @@
+#include "neat_lstm/genome_arena.h"
+
+#include <google/protobuf/arena.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Size of the first block of a new arena
+const size_t kStartBlockSize = 64 * 1024;
+
+struct Pool {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<GenomeArena>> arenas;
+};
+
+// Intentionally leaked, as genomes may outlive static destruction.
+Pool& pool() {
+  static Pool* pool = new Pool();
+  return *pool;
+}
+
+}  // namespace
+
+GenomeArena::GenomeArena() {
+  google::protobuf::ArenaOptions options;
+  options.start_block_size = kStartBlockSize;
+  arena_.reset(new google::protobuf::Arena(options));
+}
+
+std::shared_ptr<GenomeArena> GenomeArena::acquire() {
+  std::unique_ptr<GenomeArena> arena;
+  {
+    std::lock_guard<std::mutex> lock(pool().mutex);
+    if (!pool().arenas.empty()) {
+      arena = std::move(pool().arenas.back());
+      pool().arenas.pop_back();
+    }
+  }
+  if (!arena) {
+    arena.reset(new GenomeArena());
+  }
+  return std::shared_ptr<GenomeArena>(arena.release(), &GenomeArena::release);
+}
+
+Genome* GenomeArena::create() {
+  return google::protobuf::Arena::CreateMessage<Genome>(arena_.get());
+}
+
+Genome* GenomeArena::copy(const Genome& genome) {
+  Genome* copy = create();
+  copy->CopyFrom(genome);
+  return copy;
+}
+
+size_t GenomeArena::space_allocated() const {
+  return arena_->SpaceAllocated();
+}
+
+void GenomeArena::reset() {
+  // Blocks of threads other than the first are allocated separately and count
+  // towards SpaceAllocated(), so size the initial block by the space used
+  size_t used = arena_->SpaceUsed();
+  if (used <= initial_block_size_) {
+    arena_->Reset();
+    return;
+  }
+
+  // Grow the initial block past the high-water mark
+  arena_.reset();
+  initial_block_size_ = used + used / 4;
+  initial_block_.reset(new char[initial_block_size_]);
+  google::protobuf::ArenaOptions options;
+  options.initial_block = initial_block_.get();
+  options.initial_block_size = initial_block_size_;
+  options.start_block_size = kStartBlockSize;
+  arena_.reset(new google::protobuf::Arena(options));
+}
+
+void GenomeArena::release(GenomeArena* arena) {
+  arena->reset();
+  std::lock_guard<std::mutex> lock(pool().mutex);
+  pool().arenas.emplace_back(arena);
+}
@@ -0,0 +1,133 @@
+#include "neat_lstm/genome_builder.h"
+
+#include <google/protobuf/arena.h>
+#include <algorithm>
+#include <vector>
+
+#include "macros/assert.h"
+#include "neat_lstm/innovation.h"
+#include "proto/structures.pb.h"
+
+GenomeBuilder::GenomeBuilder(Genome* genome) : genome_(genome) {}
+
+GenomeBuilder::~GenomeBuilder() { build(); }
+
+Genome& GenomeBuilder::genome() { return *genome_; }
+
+int GenomeBuilder::node_count() {
+  index();
+  return nodes_.size();
+}
+
+const Node& GenomeBuilder::node(int position) {
+  index();
+  return *nodes_.at(position);
+}
+
+int GenomeBuilder::connection_count() {
+  index();
+  return connections_.size();
+}
+
+Connection* GenomeBuilder::connection(int position) {
+  index();
+  return connections_.at(position);
+}
+
+int GenomeBuilder::find_connection(int innovation) {
+  index();
+  auto it = std::lower_bound(connections_.begin(), connections_.end(),
+                             innovation,
+                             [](const Connection* c, int innovation) {
+                               return c->innovation() < innovation &&
+                                      !InnovationRegistry::provisional(
+                                          c->innovation());
+                             });
+  if (InnovationRegistry::provisional(innovation)) {
+    it = std::find_if(it, connections_.end(),
+                      [innovation](const Connection* c) {
+                        return c->innovation() == innovation;
+                      });
+  }
+  if (it == connections_.end() || (*it)->innovation() != innovation) {
+    return -1;
+  }
+  return it - connections_.begin();
+}
+
+bool GenomeBuilder::has_connection(int in_node, int out_node) {
+  index();
+  return std::any_of(connections_.begin(), connections_.end(),
+                     [in_node, out_node](const Connection* c) {
+                       return c->in_node() == in_node &&
+                              c->out_node() == out_node;
+                     });
+}
+
+Node* GenomeBuilder::new_node() {
+  return google::protobuf::Arena::CreateMessage<Node>(genome_->GetArena());
+}
+
+Connection* GenomeBuilder::new_connection() {
+  return google::protobuf::Arena::CreateMessage<Connection>(
+      genome_->GetArena());
+}
+
+int GenomeBuilder::insert_node(Node* node, int target_id) {
+  index();
+  auto target = std::find_if(
+      nodes_.begin(), nodes_.end(),
+      [target_id](const Node* node) { return node->id() == target_id; });
+  ASSERT(target != nodes_.end(), "Unknown node id: %d\n", target_id);
+  int position = target - nodes_.begin();
+  nodes_.insert(target, node);
+  genome_->mutable_nodes()->AddAllocated(node);
+  changed_ = true;
+  return position;
+}
+
+int GenomeBuilder::insert_connection(Connection* connection) {
+  index();
+  auto it = std::upper_bound(connections_.begin(), connections_.end(),
+                             connection,
+                             [](const Connection* a, const Connection* b) {
+                               return InnovationRegistry::precedes(*a, *b);
+                             });
+  int position = it - connections_.begin();
+  connections_.insert(it, connection);
+  genome_->mutable_connections()->AddAllocated(connection);
+  changed_ = true;
+  return position;
+}
+
+void GenomeBuilder::build() {
+  if (!changed_) {
+    return;
+  }
+
+  auto* nodes = genome_->mutable_nodes();
+  ASSERT(nodes->size() == (int)nodes_.size(), "Nodes: %d, Indexed: %zu\n",
+         nodes->size(), nodes_.size());
+  std::copy(nodes_.begin(), nodes_.end(), nodes->pointer_begin());
+
+  auto* connections = genome_->mutable_connections();
+  ASSERT(connections->size() == (int)connections_.size(),
+         "Connections: %d, Indexed: %zu\n", connections->size(),
+         connections_.size());
+  std::copy(connections_.begin(), connections_.end(),
+            connections->pointer_begin());
+  changed_ = false;
+}
+
+void GenomeBuilder::index() {
+  if (indexed_) {
+    return;
+  }
+  indexed_ = true;
+
+  auto* nodes = genome_->mutable_nodes();
+  nodes_.assign(nodes->pointer_begin(), nodes->pointer_end());
+  auto* connections = genome_->mutable_connections();
+  connections_.assign(connections->pointer_begin(),
+                      connections->pointer_end());
+}
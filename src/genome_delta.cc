@@ -0,0 +1,26 @@
+#include "neat_lstm/genome_delta.h"
+
+#include <vector>
+
+void GenomeDelta::weight_changed(int connection) {
+  weights_.push_back(connection);
+}
+
+void GenomeDelta::structure_changed(Type type, int index) {
+  changes_.push_back({type, index});
+}
+
+bool GenomeDelta::weights_only() const { return changes_.empty(); }
+
+bool GenomeDelta::empty() const { return weights_.empty() && changes_.empty(); }
+
+const std::vector<int>& GenomeDelta::weights() const { return weights_; }
+
+const std::vector<GenomeDelta::Change>& GenomeDelta::changes() const {
+  return changes_;
+}
+
+void GenomeDelta::clear() {
+  weights_.clear();
+  changes_.clear();
+}
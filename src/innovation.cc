@@ -1,22 +1,180 @@
 #include "neat_lstm/innovation.h"
 
+#include <algorithm>
+#include <mutex>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
-int Innovation::max_innovation_num_ = 0;
-std::unordered_map<long, int> Innovation::innovations_ = {};
+#include "proto/structures.pb.h"
 
-int Innovation::get_max() { return max_innovation_num_; }
+namespace {
 
-int Innovation::get(int in_node_id, int out_node_id) {
+// Provisional innovation numbers start here, above any committed number.
+const int kProvisionalBase = 1 << 30;
+
+// Registry of the innermost ScopedRegistry of the thread, if any
+thread_local InnovationRegistry* current_registry = nullptr;
+
+}  // namespace
+
+InnovationRegistry::InnovationRegistry() : provisional_count_(0) {}
+
+int InnovationRegistry::get_max() const { return max_innovation_num_; }
+
+int InnovationRegistry::get(int in_node_id, int out_node_id) {
   long key = hash(in_node_id, out_node_id);
-  if (innovations_.find(key) != innovations_.end()) {
-    return innovations_.at(key);
-  } else {
-    innovations_[key] = ++max_innovation_num_;
-    return max_innovation_num_;
+  auto it = innovations_.find(key);
+  if (it != innovations_.end()) {
+    return it->second;
+  }
+
+  Shard& shard = shards_[std::hash<long>()(key) % kShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto staged = shard.innovations.find(key);
+  if (staged != shard.innovations.end()) {
+    return staged->second;
+  }
+  int innovation = kProvisionalBase + provisional_count_++;
+  shard.innovations.insert({key, innovation});
+  return innovation;
+}
+
+void InnovationRegistry::commit() {
+  std::vector<std::pair<long, int>> staged;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    staged.insert(staged.end(), shard.innovations.begin(),
+                  shard.innovations.end());
+    shard.innovations.clear();
+  }
+
+  // Number in order of (in, out) pairs rather than order of arrival
+  std::sort(staged.begin(), staged.end());
+  renumbering_.assign(provisional_count_, 0);
+  for (const auto& entry : staged) {
+    innovations_[entry.first] = ++max_innovation_num_;
+    renumbering_.at(entry.second - kProvisionalBase) = max_innovation_num_;
+  }
+  provisional_count_ = 0;
+}
+
+void InnovationRegistry::renumber(Genome& genome) const {
+  auto* connections = genome.mutable_connections();
+  // Connections are sorted, so provisional numbers are at the end
+  auto first = std::find_if(
+      connections->pointer_begin(), connections->pointer_end(),
+      [](const Connection* c) { return provisional(c->innovation()); });
+  if (first == connections->pointer_end()) {
+    return;
+  }
+
+  for (auto it = first; it != connections->pointer_end(); it++) {
+    (*it)->set_innovation(
+        renumbering_.at((*it)->innovation() - kProvisionalBase));
+  }
+  std::sort(first, connections->pointer_end(),
+            [](const Connection* a, const Connection* b) {
+              return a->innovation() < b->innovation();
+            });
+}
+
+void InnovationRegistry::adopt(Genome& genome) {
+  auto* connections = genome.mutable_connections();
+  for (auto& connection : *connections) {
+    connection.set_innovation(
+        get(connection.in_node(), connection.out_node()));
+  }
+  std::sort(connections->pointer_begin(), connections->pointer_end(),
+            [](const Connection* a, const Connection* b) {
+              return precedes(*a, *b);
+            });
+}
+
+void InnovationRegistry::prune(const std::vector<const Genome*>& genomes) {
+  std::vector<long> live;
+  for (const auto* genome : genomes) {
+    for (const auto& connection : genome->connections()) {
+      live.push_back(hash(connection.in_node(), connection.out_node()));
+    }
+  }
+  std::sort(live.begin(), live.end());
+  live.erase(std::unique(live.begin(), live.end()), live.end());
+
+  for (auto it = innovations_.begin(); it != innovations_.end();) {
+    if (std::binary_search(live.begin(), live.end(), it->first)) {
+      it++;
+    } else {
+      it = innovations_.erase(it);
+    }
   }
 }
 
-long Innovation::hash(int in_node_id, int out_node_id) {
+size_t InnovationRegistry::size() const { return innovations_.size(); }
+
+std::vector<InnovationRegistry::Entry> InnovationRegistry::entries() const {
+  std::vector<std::pair<long, int>> sorted(innovations_.begin(),
+                                           innovations_.end());
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<Entry> entries;
+  entries.reserve(sorted.size());
+  for (const auto& entry : sorted) {
+    entries.push_back({(int)(entry.first >> 32), (int)entry.first,
+                       entry.second});
+  }
+  return entries;
+}
+
+void InnovationRegistry::restore(const std::vector<Entry>& entries,
+                                 int max_innovation) {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.innovations.clear();
+  }
+  provisional_count_ = 0;
+  renumbering_.clear();
+
+  innovations_.clear();
+  innovations_.reserve(entries.size());
+  for (const auto& entry : entries) {
+    innovations_[hash(entry.in_node_id, entry.out_node_id)] =
+        entry.innovation;
+  }
+  max_innovation_num_ = max_innovation;
+}
+
+bool InnovationRegistry::provisional(int innovation) {
+  return innovation >= kProvisionalBase;
+}
+
+bool InnovationRegistry::precedes(const Connection& a, const Connection& b) {
+  if (provisional(a.innovation()) && provisional(b.innovation())) {
+    return hash(a.in_node(), a.out_node()) < hash(b.in_node(), b.out_node());
+  }
+  return a.innovation() < b.innovation();
+}
+
+long InnovationRegistry::hash(int in_node_id, int out_node_id) {
   return ((long)in_node_id) << 32 | out_node_id;
 }
+
+int Innovation::get_max() { return registry().get_max(); }
+
+int Innovation::get(int in_node_id, int out_node_id) {
+  return registry().get(in_node_id, out_node_id);
+}
+
+InnovationRegistry& Innovation::registry() {
+  if (current_registry != nullptr) {
+    return *current_registry;
+  }
+  static InnovationRegistry registry;
+  return registry;
+}
+
+ScopedRegistry::ScopedRegistry(InnovationRegistry& registry)
+    : previous_(current_registry) {
+  current_registry = &registry;
+}
+
+ScopedRegistry::~ScopedRegistry() { current_registry = previous_; }
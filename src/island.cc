@@ -0,0 +1,145 @@
+#include "neat_lstm/island.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "macros/trace.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/thread_pool.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Indices of the genomes of a population by descending fitness, keeping the
+// order of genomes of equal fitness.
+std::vector<size_t> by_fitness(const Population& population) {
+  const auto& fitnesses = population.fitnesses_;
+  std::vector<size_t> order(population.genomes_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&fitnesses](size_t a, size_t b) {
+                     return fitnesses.at(a) > fitnesses.at(b);
+                   });
+  return order;
+}
+
+}  // namespace
+
+Island::Island(int index, int count) : index_(index), count_(count) {}
+
+int Island::index() const { return index_; }
+
+int Island::next_genome_id() { return index_ + count_ * genome_ids_++; }
+
+InnovationRegistry& Island::registry() { return registry_; }
+
+IslandModel::IslandModel(const Genome& seed, const Options& options,
+                         ThreadPool* pool)
+    : options_(options), pool_(pool) {
+  options_.islands = std::max<size_t>(options_.islands, 1);
+  options_.migration_interval = std::max(options_.migration_interval, 1);
+  for (size_t i = 0; i < options_.islands; i++) {
+    islands_.emplace_back(new Island(i, options_.islands));
+  }
+  populations_.resize(options_.islands);
+  for_each_island([this, &seed](size_t i) {
+    populations_.at(i).reset(new Population(seed, options_.population_size,
+                                            nullptr, nullptr,
+                                            islands_.at(i).get()));
+  });
+}
+
+void IslandModel::run_epoch(Evaluator& evaluator) {
+  TRACE_SPAN("epoch");
+  for_each_island([this, &evaluator](size_t i) {
+    TRACE_SPAN("island", i);
+    std::unique_ptr<Population>& population = populations_.at(i);
+    for (int g = 0; g < options_.migration_interval; g++) {
+      if (evaluated_ || g > 0) {
+        population.reset(new Population(population->reproduce()));
+      }
+      evaluate(*population, evaluator);
+    }
+  });
+  evaluated_ = true;
+  migrate();
+}
+
+size_t IslandModel::size() const { return populations_.size(); }
+
+const Population& IslandModel::population(size_t island) const {
+  return *populations_.at(island);
+}
+
+int IslandModel::generation() const {
+  return populations_.front()->generation();
+}
+
+void IslandModel::for_each_island(const std::function<void(size_t)>& task) {
+  if (pool_ == nullptr) {
+    for (size_t i = 0; i < populations_.size(); i++) {
+      task(i);
+    }
+    return;
+  }
+  pool_->parallel_for(populations_.size(),
+                      [&task](size_t i, size_t /*worker*/) { task(i); });
+}
+
+void IslandModel::migrate() {
+  TRACE_SPAN("migrate");
+  const size_t count = populations_.size();
+  if (count < 2 || options_.migrants == 0) {
+    return;
+  }
+
+  // Copies of the fittest genomes of every island, taken before any island
+  // receives migrants
+  std::vector<std::vector<std::pair<Genome, double>>> emigrants(count);
+  for (size_t i = 0; i < count; i++) {
+    const Population& population = *populations_.at(i);
+    std::vector<size_t> order = by_fitness(population);
+    order.resize(std::min(order.size(), options_.migrants));
+    for (size_t index : order) {
+      emigrants.at(i).emplace_back(*population.genomes_.at(index),
+                                   population.fitnesses_.at(index));
+    }
+  }
+
+  for (size_t destination = 0; destination < count; destination++) {
+    std::vector<const std::pair<Genome, double>*> arrivals;
+    for (size_t source = 0; source < count; source++) {
+      bool neighbour = options_.topology == Topology::kRing
+                           ? (source + 1) % count == destination
+                           : source != destination;
+      if (neighbour) {
+        for (const auto& emigrant : emigrants.at(source)) {
+          arrivals.push_back(&emigrant);
+        }
+      }
+    }
+
+    // Migrants replace the least fit genomes
+    Population& population = *populations_.at(destination);
+    std::vector<size_t> order = by_fitness(population);
+    std::reverse(order.begin(), order.end());
+    arrivals.resize(std::min(arrivals.size(), order.size()));
+    InnovationRegistry& registry = islands_.at(destination)->registry();
+    std::vector<Genome*> migrants;
+    for (size_t k = 0; k < arrivals.size(); k++) {
+      Genome* migrant = population.replace(order.at(k), arrivals.at(k)->first,
+                                           arrivals.at(k)->second);
+      registry.adopt(*migrant);
+      migrants.push_back(migrant);
+    }
+    registry.commit();
+    for (Genome* migrant : migrants) {
+      registry.renumber(*migrant);
+    }
+    population.speciate();
+  }
+}
@@ -0,0 +1,405 @@
+#include "neat_lstm/journal.h"
+
+#include <dirent.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/record_io.h"
+#include "proto/journal.pb.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+const uint32_t kJournalMagic = 0x4C4A4E4E;  // "NNJL"
+
+// Size of the trailer after the index: its byte size and the magic number
+const size_t kTrailerSize = 12;
+
+// Size of the buffer of a segment file. Generations are written in a few
+// large writes rather than one per record.
+const size_t kBufferSize = 1 << 20;
+
+const char kSegmentSuffix[] = ".journal";
+
+uint64_t read_fixed64(const uint8_t* data) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = value << 8 | data[i];
+  }
+  return value;
+}
+
+uint32_t read_fixed32(const uint8_t* data) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = value << 8 | data[i];
+  }
+  return value;
+}
+
+// Parses the index of a segment file, and the size of the records before it.
+// Returns false if the trailer or the index is corrupt.
+bool parse_index(const utils::MappedFile& file, JournalIndex* index,
+                 uint64_t* records) {
+  const uint8_t* data = file.data();
+  const size_t size = file.size();
+  if (size < kTrailerSize || read_fixed32(data + size - 4) != kJournalMagic) {
+    return false;
+  }
+  const uint64_t index_size = read_fixed64(data + size - kTrailerSize);
+  if (index_size > size - kTrailerSize ||
+      !index->ParseFromArray(data + size - kTrailerSize - index_size,
+                             index_size)) {
+    return false;
+  }
+  *records = size - kTrailerSize - index_size;
+  return true;
+}
+
+}  // namespace
+
+JournalWriter::JournalWriter(const std::string& directory,
+                             int generations_per_segment)
+    : directory_(directory),
+      generations_per_segment_(generations_per_segment),
+      buffer_(kBufferSize) {}
+
+JournalWriter::~JournalWriter() { close(); }
+
+void JournalWriter::append(const Population& population) {
+  // Shallow copy, keeping the genomes' arena alive
+  std::shared_ptr<Population> job(new Population(population));
+  writer_.submit([this, job]() { return write(*job); });
+}
+
+bool JournalWriter::close() {
+  writer_.submit([this]() { return finish_segment(); });
+  return writer_.flush();
+}
+
+const std::string& JournalWriter::error() const { return writer_.error(); }
+
+std::string JournalWriter::write(const Population& population) {
+  const int generation = population.generation();
+  const int segment = (generation - 1) / generations_per_segment_;
+  if (segment != segment_) {
+    std::string error = finish_segment();
+    if (!error.empty()) {
+      return error;
+    }
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+      return "Cannot create " + directory_ + ": " + std::strerror(errno);
+    }
+    const std::string temporary = segment_path(segment) + ".tmp";
+    output_.rdbuf()->pubsetbuf(buffer_.data(), buffer_.size());
+    output_.open(temporary, std::ios::binary | std::ios::trunc);
+    if (!output_) {
+      return "Cannot open " + temporary + ": " + std::strerror(errno);
+    }
+    segment_ = segment;
+    offset_ = 0;
+    index_.Clear();
+    error = keep_earlier(generation);
+    if (!error.empty()) {
+      return error;
+    }
+  }
+
+  const auto& genomes = population.genomes_;
+  auto* entry = index_.add_generations();
+  entry->set_generation(generation);
+  entry->set_offset(offset_);
+  entry->set_count(genomes.size());
+
+  // The genome is written as the last field of its record, rather than copied
+  // into the record
+  const uint32_t genome_tag =
+      WireFormatLite::MakeTag(JournalRecord::kGenomeFieldNumber,
+                              WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  google::protobuf::io::OstreamOutputStream stream(&output_);
+  CodedOutputStream coded(&stream);
+  JournalRecord record;
+  record.set_generation(generation);
+  for (size_t i = 0; i < genomes.size(); i++) {
+    const Genome& genome = *genomes.at(i);
+    const Parents& parents = population.parents().at(i);
+    record.set_fitness(population.fitnesses_.at(i));
+    record.set_species(population.species_ids().at(i));
+    record.clear_parent_ids();
+    if (parents.first >= 0) {
+      record.add_parent_ids(parents.first);
+    }
+    if (parents.second >= 0) {
+      record.add_parent_ids(parents.second);
+    }
+
+    size_t genome_size = genome.ByteSizeLong();
+    size_t size = record.ByteSizeLong() +
+                  CodedOutputStream::VarintSize32(genome_tag) +
+                  CodedOutputStream::VarintSize64(genome_size) + genome_size;
+    coded.WriteVarint64(size);
+    record.SerializeWithCachedSizes(&coded);
+    coded.WriteVarint32(genome_tag);
+    coded.WriteVarint64(genome_size);
+    genome.SerializeWithCachedSizes(&coded);
+
+    index_.add_genome_ids(genome.id());
+    index_.add_genome_offsets(offset_);
+    offset_ += CodedOutputStream::VarintSize64(size) + size;
+  }
+  if (coded.HadError()) {
+    return "Cannot write " + segment_path(segment_) + ".tmp";
+  }
+  return "";
+}
+
+std::string JournalWriter::finish_segment() {
+  if (segment_ < 0) {
+    return "";
+  }
+  const std::string path = segment_path(segment_);
+  const std::string temporary = path + ".tmp";
+  segment_ = -1;
+
+  // Order the genome index by id. Records were appended in generation order,
+  // so a stable sort keeps the records of an id in generation order.
+  const size_t count = index_.genome_ids_size();
+  std::vector<std::pair<int, uint64_t>> genomes(count);
+  for (size_t i = 0; i < count; i++) {
+    genomes.at(i) = {index_.genome_ids(i), index_.genome_offsets(i)};
+  }
+  std::stable_sort(genomes.begin(), genomes.end(),
+                   [](const std::pair<int, uint64_t>& a,
+                      const std::pair<int, uint64_t>& b) {
+                     return a.first < b.first;
+                   });
+  for (size_t i = 0; i < count; i++) {
+    index_.set_genome_ids(i, genomes.at(i).first);
+    index_.set_genome_offsets(i, genomes.at(i).second);
+  }
+
+  {
+    google::protobuf::io::OstreamOutputStream stream(&output_);
+    CodedOutputStream coded(&stream);
+    const uint64_t index_size = index_.ByteSizeLong();
+    index_.SerializeWithCachedSizes(&coded);
+    coded.WriteLittleEndian64(index_size);
+    coded.WriteLittleEndian32(kJournalMagic);
+  }
+  index_.Clear();
+  output_.close();
+  if (!output_) {
+    output_.clear();
+    return "Cannot write " + temporary;
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    return "Cannot rename " + temporary + ": " + std::strerror(errno);
+  }
+  return "";
+}
+
+std::string JournalWriter::keep_earlier(int generation) {
+  const std::string path = segment_path(segment_);
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return errno == ENOENT
+               ? ""
+               : "Cannot stat " + path + ": " + std::strerror(errno);
+  }
+  utils::MappedFile file;
+  std::string error;
+  if (!file.open(path, &error)) {
+    return error;
+  }
+  JournalIndex previous;
+  uint64_t records;
+  if (!parse_index(file, &previous, &records)) {
+    return "Corrupt journal segment " + path;
+  }
+
+  // Records of a generation are contiguous and generations ascend, so the
+  // records kept are a prefix of the file
+  uint64_t end = records;
+  for (const auto& entry : previous.generations()) {
+    if (entry.generation() >= generation) {
+      end = std::min(end, entry.offset());
+      break;
+    }
+    *index_.add_generations() = entry;
+  }
+  for (int i = 0; i < previous.genome_ids_size(); i++) {
+    if (previous.genome_offsets(i) < end) {
+      index_.add_genome_ids(previous.genome_ids(i));
+      index_.add_genome_offsets(previous.genome_offsets(i));
+    }
+  }
+  output_.write(reinterpret_cast<const char*>(file.data()), end);
+  offset_ = end;
+  if (!output_) {
+    return "Cannot write " + path + ".tmp";
+  }
+  return "";
+}
+
+std::string JournalWriter::segment_path(int segment) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%08d%s", segment, kSegmentSuffix);
+  return directory_ + "/" + name;
+}
+
+bool JournalReader::open(const std::string& directory) {
+  segments_.clear();
+  DIR* dir = opendir(directory.c_str());
+  if (dir == nullptr) {
+    error_ = "Cannot open " + directory + ": " + std::strerror(errno);
+    return false;
+  }
+  std::vector<std::string> names;
+  const size_t suffix_size = std::strlen(kSegmentSuffix);
+  while (const dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.size() > suffix_size &&
+        name.compare(name.size() - suffix_size, suffix_size,
+                     kSegmentSuffix) == 0) {
+      names.push_back(name);
+    }
+  }
+  closedir(dir);
+  // Segment numbers are zero-padded, so names sort in generation order
+  std::sort(names.begin(), names.end());
+
+  for (const auto& name : names) {
+    const std::string path = directory + "/" + name;
+    Segment segment;
+    if (!segment.file.open(path, &error_)) {
+      segments_.clear();
+      return false;
+    }
+    uint64_t records = 0;
+    bool valid = parse_index(segment.file, &segment.index, &records);
+
+    // Check that lookups stay within the records
+    const JournalIndex& index = segment.index;
+    valid = valid && !index.generations().empty() &&
+            index.genome_ids_size() == index.genome_offsets_size();
+    for (int i = 0; valid && i < index.generations_size(); i++) {
+      valid = index.generations(i).offset() < records &&
+              (i == 0 || index.generations(i - 1).generation() <
+                             index.generations(i).generation());
+    }
+    for (uint64_t offset : index.genome_offsets()) {
+      valid = valid && offset < records;
+    }
+    if (valid && !segments_.empty()) {
+      const JournalIndex& previous = segments_.back().index;
+      valid = previous.generations(previous.generations_size() - 1)
+                  .generation() < index.generations(0).generation();
+    }
+    if (!valid) {
+      error_ = "Corrupt journal segment " + path;
+      segments_.clear();
+      return false;
+    }
+    segments_.push_back(std::move(segment));
+  }
+  return true;
+}
+
+int JournalReader::first_generation() const {
+  if (segments_.empty()) {
+    return -1;
+  }
+  return segments_.front().index.generations(0).generation();
+}
+
+int JournalReader::last_generation() const {
+  if (segments_.empty()) {
+    return -1;
+  }
+  const JournalIndex& index = segments_.back().index;
+  return index.generations(index.generations_size() - 1).generation();
+}
+
+bool JournalReader::generation(int generation,
+                               std::vector<JournalRecord>* records) const {
+  records->clear();
+  // Find the last segment starting at or before the generation
+  auto segment = std::upper_bound(
+      segments_.begin(), segments_.end(), generation,
+      [](int generation, const Segment& segment) {
+        return generation < segment.index.generations(0).generation();
+      });
+  if (segment == segments_.begin()) {
+    return false;
+  }
+  segment--;
+
+  const auto& generations = segment->index.generations();
+  auto entry = std::lower_bound(
+      generations.begin(), generations.end(), generation,
+      [](const JournalIndex::Generation& entry, int generation) {
+        return entry.generation() < generation;
+      });
+  if (entry == generations.end() || entry->generation() != generation) {
+    return false;
+  }
+
+  // Records of a generation are contiguous
+  const uint8_t* data = segment->file.data();
+  const size_t size = segment->file.size();
+  size_t position = entry->offset();
+  records->resize(entry->count());
+  for (auto& record : *records) {
+    size_t start;
+    size_t length;
+    if (!utils::find_record(data, size, position, &start, &length) ||
+        !record.ParseFromArray(data + start, length)) {
+      records->clear();
+      return false;
+    }
+    position = start + length;
+  }
+  return true;
+}
+
+bool JournalReader::genome(int id, std::vector<JournalRecord>* records) const {
+  records->clear();
+  for (const Segment& segment : segments_) {
+    const auto& ids = segment.index.genome_ids();
+    auto range = std::equal_range(ids.begin(), ids.end(), id);
+    for (auto it = range.first; it != range.second; it++) {
+      uint64_t offset = segment.index.genome_offsets(it - ids.begin());
+      records->emplace_back();
+      if (!record(segment, offset, &records->back())) {
+        records->clear();
+        return false;
+      }
+    }
+  }
+  return !records->empty();
+}
+
+const std::string& JournalReader::error() const { return error_; }
+
+bool JournalReader::record(const Segment& segment, uint64_t offset,
+                           JournalRecord* record) const {
+  size_t start;
+  size_t length;
+  return utils::find_record(segment.file.data(), segment.file.size(), offset,
+                            &start, &length) &&
+         record->ParseFromArray(segment.file.data() + start, length);
+}
@@ -0,0 +1,308 @@
+#include "neat_lstm/lstm_kernel.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "macros/assert.h"
+#include "neat_lstm/activation.h"
+#include "proto/structures.pb.h"
+
+namespace {
+
+// Rounds a row length up to a multiple of 64 bytes, i.e. one 512-bit vector
+// or one cache line: 8 doubles or 16 floats.
+template <typename Scalar>
+int padded_length(int length) {
+  const int padding = 64 / sizeof(Scalar);
+  return (length + padding - 1) / padding * padding;
+}
+
+enum Gate { INPUT_GATE = 0, FORGET_GATE = 1, STATE_GATE = 2, OUTPUT_GATE = 3 };
+
+#if defined(__AVX2__) && !defined(__AVX512F__)
+double horizontal_sum(__m256d values) {
+  __m128d low = _mm256_castpd256_pd128(values);
+  __m128d high = _mm256_extractf128_pd(values, 1);
+  low = _mm_add_pd(low, high);
+  high = _mm_unpackhi_pd(low, low);
+  return _mm_cvtsd_f64(_mm_add_sd(low, high));
+}
+
+float horizontal_sum(__m256 values) {
+  __m128 low = _mm256_castps256_ps128(values);
+  __m128 high = _mm256_extractf128_ps(values, 1);
+  low = _mm_add_ps(low, high);
+  high = _mm_movehl_ps(high, low);
+  low = _mm_add_ps(low, high);
+  high = _mm_shuffle_ps(low, low, 1);
+  return _mm_cvtss_f32(_mm_add_ss(low, high));
+}
+#endif
+
+// Computes the dot products of the four gate rows of a cell (each stride
+// values apart in weights) with variables, writing them to sums.
+void fused_dot(const double* weights, const double* variables, int stride,
+               double* sums) {
+  const double* w_0 = weights;
+  const double* w_1 = weights + stride;
+  const double* w_2 = weights + 2 * stride;
+  const double* w_3 = weights + 3 * stride;
+#if defined(__AVX512F__)
+  __m512d s_0 = _mm512_setzero_pd();
+  __m512d s_1 = _mm512_setzero_pd();
+  __m512d s_2 = _mm512_setzero_pd();
+  __m512d s_3 = _mm512_setzero_pd();
+  for (int j = 0; j < stride; j += 8) {
+    __m512d x = _mm512_load_pd(variables + j);
+    s_0 = _mm512_fmadd_pd(_mm512_load_pd(w_0 + j), x, s_0);
+    s_1 = _mm512_fmadd_pd(_mm512_load_pd(w_1 + j), x, s_1);
+    s_2 = _mm512_fmadd_pd(_mm512_load_pd(w_2 + j), x, s_2);
+    s_3 = _mm512_fmadd_pd(_mm512_load_pd(w_3 + j), x, s_3);
+  }
+  sums[0] = _mm512_reduce_add_pd(s_0);
+  sums[1] = _mm512_reduce_add_pd(s_1);
+  sums[2] = _mm512_reduce_add_pd(s_2);
+  sums[3] = _mm512_reduce_add_pd(s_3);
+#elif defined(__AVX2__)
+  __m256d s_0 = _mm256_setzero_pd();
+  __m256d s_1 = _mm256_setzero_pd();
+  __m256d s_2 = _mm256_setzero_pd();
+  __m256d s_3 = _mm256_setzero_pd();
+  for (int j = 0; j < stride; j += 4) {
+    __m256d x = _mm256_load_pd(variables + j);
+#if defined(__FMA__)
+    s_0 = _mm256_fmadd_pd(_mm256_load_pd(w_0 + j), x, s_0);
+    s_1 = _mm256_fmadd_pd(_mm256_load_pd(w_1 + j), x, s_1);
+    s_2 = _mm256_fmadd_pd(_mm256_load_pd(w_2 + j), x, s_2);
+    s_3 = _mm256_fmadd_pd(_mm256_load_pd(w_3 + j), x, s_3);
+#else
+    s_0 = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(w_0 + j), x), s_0);
+    s_1 = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(w_1 + j), x), s_1);
+    s_2 = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(w_2 + j), x), s_2);
+    s_3 = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(w_3 + j), x), s_3);
+#endif
+  }
+  sums[0] = horizontal_sum(s_0);
+  sums[1] = horizontal_sum(s_1);
+  sums[2] = horizontal_sum(s_2);
+  sums[3] = horizontal_sum(s_3);
+#else
+  double s_0 = 0;
+  double s_1 = 0;
+  double s_2 = 0;
+  double s_3 = 0;
+  for (int j = 0; j < stride; j++) {
+    double x = variables[j];
+    s_0 += w_0[j] * x;
+    s_1 += w_1[j] * x;
+    s_2 += w_2[j] * x;
+    s_3 += w_3[j] * x;
+  }
+  sums[0] = s_0;
+  sums[1] = s_1;
+  sums[2] = s_2;
+  sums[3] = s_3;
+#endif
+}
+
+// Single precision version of the above
+void fused_dot(const float* weights, const float* variables, int stride,
+               float* sums) {
+  const float* w_0 = weights;
+  const float* w_1 = weights + stride;
+  const float* w_2 = weights + 2 * stride;
+  const float* w_3 = weights + 3 * stride;
+#if defined(__AVX512F__)
+  __m512 s_0 = _mm512_setzero_ps();
+  __m512 s_1 = _mm512_setzero_ps();
+  __m512 s_2 = _mm512_setzero_ps();
+  __m512 s_3 = _mm512_setzero_ps();
+  for (int j = 0; j < stride; j += 16) {
+    __m512 x = _mm512_load_ps(variables + j);
+    s_0 = _mm512_fmadd_ps(_mm512_load_ps(w_0 + j), x, s_0);
+    s_1 = _mm512_fmadd_ps(_mm512_load_ps(w_1 + j), x, s_1);
+    s_2 = _mm512_fmadd_ps(_mm512_load_ps(w_2 + j), x, s_2);
+    s_3 = _mm512_fmadd_ps(_mm512_load_ps(w_3 + j), x, s_3);
+  }
+  sums[0] = _mm512_reduce_add_ps(s_0);
+  sums[1] = _mm512_reduce_add_ps(s_1);
+  sums[2] = _mm512_reduce_add_ps(s_2);
+  sums[3] = _mm512_reduce_add_ps(s_3);
+#elif defined(__AVX2__)
+  __m256 s_0 = _mm256_setzero_ps();
+  __m256 s_1 = _mm256_setzero_ps();
+  __m256 s_2 = _mm256_setzero_ps();
+  __m256 s_3 = _mm256_setzero_ps();
+  for (int j = 0; j < stride; j += 8) {
+    __m256 x = _mm256_load_ps(variables + j);
+#if defined(__FMA__)
+    s_0 = _mm256_fmadd_ps(_mm256_load_ps(w_0 + j), x, s_0);
+    s_1 = _mm256_fmadd_ps(_mm256_load_ps(w_1 + j), x, s_1);
+    s_2 = _mm256_fmadd_ps(_mm256_load_ps(w_2 + j), x, s_2);
+    s_3 = _mm256_fmadd_ps(_mm256_load_ps(w_3 + j), x, s_3);
+#else
+    s_0 = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(w_0 + j), x), s_0);
+    s_1 = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(w_1 + j), x), s_1);
+    s_2 = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(w_2 + j), x), s_2);
+    s_3 = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(w_3 + j), x), s_3);
+#endif
+  }
+  sums[0] = horizontal_sum(s_0);
+  sums[1] = horizontal_sum(s_1);
+  sums[2] = horizontal_sum(s_2);
+  sums[3] = horizontal_sum(s_3);
+#else
+  float s_0 = 0;
+  float s_1 = 0;
+  float s_2 = 0;
+  float s_3 = 0;
+  for (int j = 0; j < stride; j++) {
+    float x = variables[j];
+    s_0 += w_0[j] * x;
+    s_1 += w_1[j] * x;
+    s_2 += w_2[j] * x;
+    s_3 += w_3[j] * x;
+  }
+  sums[0] = s_0;
+  sums[1] = s_1;
+  sums[2] = s_2;
+  sums[3] = s_3;
+#endif
+}
+
+}  // namespace
+
+template <typename Scalar>
+LSTMKernel<Scalar>::LSTMKernel(const LSTMUnit& lstm_unit, int input_size,
+                               activation::Mode mode) {
+  rebuild(lstm_unit, input_size, mode);
+}
+
+template <typename Scalar>
+void LSTMKernel<Scalar>::rebuild(const LSTMUnit& lstm_unit, int input_size,
+                                 activation::Mode mode) {
+  capacity_ = lstm_unit.capacity();
+  input_size_ = input_size;
+  mode_ = mode;
+  stride_ = padded_length<Scalar>(capacity_ + input_size);
+  weights_.assign(capacity_ * 4 * stride_, 0);
+  variables_.assign(stride_, 0);
+  gates_.assign(capacity_ * 4, 0);
+  state_.assign(capacity_, 0);
+  activations_.assign(capacity_, 0);
+
+  const int columns = capacity_ + input_size_;
+  // Check correct dimensions
+  ASSERT(lstm_unit.input_weights_size() == capacity_ * columns &&
+             lstm_unit.forget_weights_size() == capacity_ * columns &&
+             lstm_unit.state_weights_size() == capacity_ * columns &&
+             lstm_unit.output_weights_size() == capacity_ * columns,
+         "Capacity: %d, Input size: %d\n", capacity_, input_size_);
+
+  // Interleave the gate matrices row by row
+  const google::protobuf::RepeatedField<double>* gate_weights[4];
+  gate_weights[INPUT_GATE] = &lstm_unit.input_weights();
+  gate_weights[FORGET_GATE] = &lstm_unit.forget_weights();
+  gate_weights[STATE_GATE] = &lstm_unit.state_weights();
+  gate_weights[OUTPUT_GATE] = &lstm_unit.output_weights();
+  for (int i = 0; i < capacity_; i++) {
+    for (int g = 0; g < 4; g++) {
+      std::copy_n(gate_weights[g]->begin() + i * columns, columns,
+                  &weights_[(i * 4 + g) * stride_]);
+    }
+  }
+
+  biases_[INPUT_GATE] = lstm_unit.input_bias();
+  biases_[FORGET_GATE] = lstm_unit.forget_bias();
+  biases_[STATE_GATE] = lstm_unit.state_bias();
+  biases_[OUTPUT_GATE] = lstm_unit.output_bias();
+}
+
+template <typename Scalar>
+int LSTMKernel<Scalar>::capacity() const {
+  return capacity_;
+}
+
+template <typename Scalar>
+int LSTMKernel<Scalar>::input_size() const {
+  return input_size_;
+}
+
+template <typename Scalar>
+Scalar* LSTMKernel<Scalar>::inputs() {
+  return &variables_[capacity_];
+}
+
+template <typename Scalar>
+void LSTMKernel<Scalar>::step() {
+  Scalar sums[4];
+  for (int i = 0; i < capacity_; i++) {
+    fused_dot(&weights_[i * 4 * stride_], variables_.data(), stride_, sums);
+    for (int g = 0; g < 4; g++) {
+      gates_[g * capacity_ + i] = sums[g] + biases_[g];
+    }
+  }
+
+  // The input and forget gates are adjacent
+  Scalar* i_t = &gates_[INPUT_GATE * capacity_];
+  Scalar* f_t = &gates_[FORGET_GATE * capacity_];
+  Scalar* c_t = &gates_[STATE_GATE * capacity_];
+  Scalar* o_t = &gates_[OUTPUT_GATE * capacity_];
+  activation::sigmoid(i_t, i_t, 2 * capacity_, mode_);
+  activation::tanh(c_t, c_t, capacity_, mode_);
+  activation::sigmoid(o_t, o_t, capacity_, mode_);
+
+  for (int i = 0; i < capacity_; i++) {
+    state_[i] = f_t[i] * state_[i] + i_t[i] * c_t[i];
+  }
+  activation::tanh(state_.data(), activations_.data(), capacity_, mode_);
+  for (int i = 0; i < capacity_; i++) {
+    activations_[i] *= o_t[i];
+  }
+
+  // h_{t-1} is only replaced once every cell has read it
+  std::copy_n(activations_.data(), capacity_, variables_.data());
+}
+
+template <typename Scalar>
+const Scalar* LSTMKernel<Scalar>::activations() const {
+  return activations_.data();
+}
+
+template <typename Scalar>
+const Scalar* LSTMKernel<Scalar>::state() const {
+  return state_.data();
+}
+
+template <typename Scalar>
+void LSTMKernel<Scalar>::reset() {
+  std::fill(state_.begin(), state_.end(), 0);
+  std::fill(activations_.begin(), activations_.end(), 0);
+  std::fill_n(variables_.begin(), capacity_, 0);
+}
+
+template <typename Scalar>
+int LSTMKernel<Scalar>::state_size() const {
+  return 2 * capacity_;
+}
+
+template <typename Scalar>
+void LSTMKernel<Scalar>::save_state(Scalar* state) const {
+  state = std::copy(state_.begin(), state_.end(), state);
+  std::copy(activations_.begin(), activations_.end(), state);
+}
+
+template <typename Scalar>
+void LSTMKernel<Scalar>::restore_state(const Scalar* state) {
+  std::copy_n(state, capacity_, state_.begin());
+  std::copy_n(state + capacity_, capacity_, activations_.begin());
+  // h_{t-1} for the next step()
+  std::copy_n(state + capacity_, capacity_, variables_.begin());
+}
+
+template class LSTMKernel<float>;
+template class LSTMKernel<double>;
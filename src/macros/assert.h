@@ -15,8 +15,8 @@
     }                                                                  \
   } while (false)
 #else
-#define ASSERT(condition, message) \
-  do {                             \
+#define ASSERT(condition, ...) \
+  do {                         \
   } while (false)
 #endif
 
@@ -0,0 +1,24 @@
+#ifndef NEAT_LSTM_MACROS_STATS_H
+#define NEAT_LSTM_MACROS_STATS_H
+
+#include "neat_lstm/stats.h"
+
+#define STATS_CONCAT_(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_(a, b)
+
+#ifdef NEAT_LSTM_STATS
+// Times the rest of the enclosing scope as the phase.
+#define STATS_TIMER(phase) \
+  ::stats::ScopedTimer STATS_CONCAT(stats_timer_, __LINE__)(phase)
+// Adds value to the counter.
+#define STATS_COUNT(counter, value) ::stats::count(counter, value)
+#else
+#define STATS_TIMER(phase) \
+  do {                     \
+  } while (false)
+#define STATS_COUNT(counter, value) \
+  do {                              \
+  } while (false)
+#endif
+
+#endif
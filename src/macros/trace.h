@@ -0,0 +1,20 @@
+#ifndef NEAT_LSTM_MACROS_TRACE_H
+#define NEAT_LSTM_MACROS_TRACE_H
+
+#include "neat_lstm/trace.h"
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef NEAT_LSTM_TRACE
+// Records the rest of the enclosing scope as a span named by a string
+// literal, optionally with an integer argument such as a genome id.
+#define TRACE_SPAN(...) \
+  ::trace::ScopedSpan TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#else
+#define TRACE_SPAN(...) \
+  do {                  \
+  } while (false)
+#endif
+
+#endif
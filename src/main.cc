@@ -1,25 +1,188 @@
 #include <google/protobuf/text_format.h>
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <sstream>
+#include <string>
 #include <vector>
 
+#include "macros/trace.h"
+#include "neat_lstm/activation.h"
+#include "neat_lstm/checkpoint.h"
+#include "neat_lstm/compiled_network.h"
 #include "neat_lstm/config_store.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/island.h"
+#include "neat_lstm/journal.h"
 #include "neat_lstm/mutation.h"
 #include "neat_lstm/network.h"
+#include "neat_lstm/network_pool.h"
 #include "neat_lstm/population.h"
+#include "neat_lstm/stats.h"
+#include "neat_lstm/thread_pool.h"
+#include "neat_lstm/trace.h"
+#include "neat_lstm/worker_fleet.h"
 #include "neat_lstm/utils/genome_utils.h"
+#include "neat_lstm/utils/random.h"
 #include "proto/config.pb.h"
 #include "proto/structures.pb.h"
 
 using google::protobuf::TextFormat;
 
+namespace {
+
+// Fitness of a genome on the XOR truth table, (4 - total error)^2
+// Networks are evaluated in the precision and activation mode set in the
+// config, with the network pool of the evaluating thread, so evaluation does
+// not allocate once the pools have grown to fit the population.
+class XorEvaluator : public Evaluator {
+ public:
+  // Number of rows of the truth table
+  static const size_t kTests = 4;
+  typedef std::array<double, kTests> Outputs;
+
+  XorEvaluator()
+      : precision_(ConfigStore::evaluation().precision()),
+        mode_(ConfigStore::evaluation().fast_activations()
+                  ? activation::Mode::kFast
+                  : activation::Mode::kExact) {
+    std::map<std::pair<double, double>, double> tests = {
+        {{0, 0}, 0}, {{0, 1}, 1}, {{1, 0}, 1}, {{1, 1}, 0}};
+
+    // Tests as a row-major batch of inputs and expected outputs
+    for (const auto& test : tests) {
+      inputs_.push_back(test.first.first);
+      inputs_.push_back(test.first.second);
+      outputs_.push_back(test.second);
+    }
+  }
+
+  double evaluate(const Genome& genome) override {
+    if (precision_ == Config::Evaluation::FLOAT) {
+      return fitness(outputs<float>(genome));
+    }
+    return fitness(outputs<double>(genome));
+  }
+
+  // Outputs of the genome's network on the tests, evaluated in Scalar.
+  template <typename Scalar>
+  Outputs outputs(const Genome& genome) const {
+    Scalar inputs[kTests * 2];
+    std::copy(inputs_.begin(), inputs_.end(), inputs);
+    Scalar outputs[kTests];
+    CompiledNetwork<Scalar>& network =
+        NetworkPool<Scalar>::local().acquire(genome, mode_);
+    network.activate_batch(inputs, kTests, outputs);
+    Outputs result;
+    std::copy(outputs, outputs + kTests, result.begin());
+    return result;
+  }
+
+  double fitness(const Outputs& outputs) const {
+    double fitness = 0;
+    for (size_t t = 0; t < outputs_.size(); t++) {
+      fitness += std::abs(outputs_.at(t) - outputs.at(t));
+    }
+    fitness = 4 - fitness;
+    return fitness * fitness;
+  }
+
+ private:
+  Config::Evaluation::Precision precision_;
+  activation::Mode mode_;
+  std::vector<double> inputs_;
+  std::vector<double> outputs_;
+};
+
+// Prints how far single precision evaluation strays from double precision on
+// the genomes of the population: the largest differences in outputs and in
+// fitness, and the number of outputs rounding to a different class.
+void report_precision(const XorEvaluator& evaluator,
+                      const Population& population) {
+  double max_output_error = 0;
+  double max_fitness_error = 0;
+  int flipped_outputs = 0;
+  for (const Genome* genome : population.genomes_) {
+    auto outputs = evaluator.outputs<double>(*genome);
+    auto float_outputs = evaluator.outputs<float>(*genome);
+    for (size_t t = 0; t < outputs.size(); t++) {
+      max_output_error =
+          std::max(max_output_error, std::abs(outputs[t] - float_outputs[t]));
+      flipped_outputs += (outputs[t] < 0.5) != (float_outputs[t] < 0.5);
+    }
+    max_fitness_error =
+        std::max(max_fitness_error, std::abs(evaluator.fitness(outputs) -
+                                             evaluator.fitness(float_outputs)));
+  }
+  std::cout << "Float vs double on " << population.genomes_.size()
+            << " genomes: max output error " << max_output_error
+            << ", max fitness error " << max_fitness_error
+            << ", flipped outputs " << flipped_outputs << std::endl;
+}
+
+// Evolves islands of 150 genomes each for the number of generations, printing
+// the best genome over all islands after every migration.
+void run_islands(const Genome& seed, Evaluator& evaluator, ThreadPool& pool,
+                 int generations) {
+  const Config::Islands& config = ConfigStore::islands();
+  IslandModel::Options options;
+  options.islands = config.count();
+  options.population_size = 150;
+  if (config.migration_interval() > 0) {
+    options.migration_interval = config.migration_interval();
+  }
+  options.migrants = config.migrants();
+  options.topology = config.topology() == Config::Islands::FULLY_CONNECTED
+                         ? IslandModel::Topology::kFullyConnected
+                         : IslandModel::Topology::kRing;
+  IslandModel model{seed, options, &pool};
+
+  const Genome* best = nullptr;
+  do {
+    model.run_epoch(evaluator);
+    double max_fitness = -10000;
+    size_t species = 0;
+    for (size_t i = 0; i < model.size(); i++) {
+      const Population& population = model.population(i);
+      species += population.species_size();
+      for (size_t j = 0; j < population.genomes_.size(); j++) {
+        if (population.fitnesses_.at(j) > max_fitness) {
+          max_fitness = population.fitnesses_.at(j);
+          best = population.genomes_.at(j);
+        }
+      }
+    }
+    std::cout << "Gen " << model.generation() << ": " << max_fitness
+              << "\t\tNum species: " << species
+              << "\t\tBest in gen: " << best->id() << std::endl;
+  } while (model.generation() < generations);
+  std::cout << best->DebugString() << std::endl;
+}
+
+}  // namespace
+
 // Currently running XOR test
-// ./neat_lstm res/default.config
+// ./neat_lstm res/default.config [seed] [checkpoint] [journal] [stats] [trace]
+// If the checkpoint file exists, evolution resumes from it. The checkpoint is
+// rewritten every kCheckpointInterval generations, once the generation is
+// evaluated, so that it holds real fitnesses. If a journal directory is
+// given, every evaluated generation is recorded in it. If a stats file is
+// given, the phase timings and counters of each generation are written to it,
+// as JSON Lines if its name ends with .json and as CSV otherwise. If a trace
+// file is given, a timeline of the run is written to it as Chrome trace JSON.
+// Empty arguments are skipped. With islands in the config, none of the
+// optional files but the trace is supported.
 int main(int argc, char* argv[]) {
+  const int kCheckpointInterval = 50;
+  if (argc > 2) {
+    utils::random::seed(std::stoull(argv[2]));
+  }
+  std::cout << "Seed: " << utils::random::seed() << std::endl;
+
   std::ifstream config_input(argv[1]);
   std::stringstream config_buffer;
   config_buffer << config_input.rdbuf();
@@ -29,10 +192,57 @@ int main(int argc, char* argv[]) {
 
   Genome xor_genome = utils::create_genome(2, 1);
 
-  Population population{xor_genome, 150};
+  XorEvaluator evaluator;
+  if (ConfigStore::islands().count() > 1) {
+    for (int i = 3; i < std::min(argc, 6); i++) {
+      if (argv[i][0] != '\0') {
+        std::cerr << "Islands cannot be checkpointed, journaled or recorded"
+                  << std::endl;
+        return 1;
+      }
+    }
+    ThreadPool pool;
+    std::string trace_path = argc > 6 ? argv[6] : "";
+    if (!trace_path.empty()) {
+      trace::start();
+    }
+    run_islands(xor_genome, evaluator, pool, 1000);
+    if (!trace_path.empty()) {
+      trace::stop();
+      if (!trace::write(trace_path)) {
+        std::cerr << "Cannot write " << trace_path << std::endl;
+        return 1;
+      }
+    }
+    return 0;
+  }
+  // Worker processes are forked before any threads are started
+  std::unique_ptr<WorkerFleet> fleet;
+  if (ConfigStore::evaluation().worker_processes() > 0) {
+    WorkerFleet::Options options;
+    options.workers = ConfigStore::evaluation().worker_processes();
+    if (ConfigStore::evaluation().worker_batch_size() > 0) {
+      options.batch_size = ConfigStore::evaluation().worker_batch_size();
+    }
+    fleet.reset(new WorkerFleet(evaluator, options));
+    if (!fleet->start()) {
+      std::cerr << fleet->error() << std::endl;
+      return 1;
+    }
+  }
+  ThreadPool pool;
 
-  std::map<std::pair<double, double>, double> tests = {
-      {{0, 0}, 0}, {{0, 1}, 1}, {{1, 0}, 1}, {{1, 1}, 0}};
+  std::string checkpoint_path = argc > 3 ? argv[3] : "";
+  CheckpointReader checkpoint;
+  bool resume = !checkpoint_path.empty() && std::ifstream(checkpoint_path);
+  if (resume && !checkpoint.open(checkpoint_path)) {
+    std::cerr << checkpoint.error() << std::endl;
+    return 1;
+  }
+  std::unique_ptr<Population> population;
+  if (!resume) {
+    population.reset(new Population{xor_genome, 150, &pool});
+  }
 
   Genome test = utils::create_genome(2, 1);
 
@@ -44,37 +254,108 @@ int main(int argc, char* argv[]) {
   test_net.activate({1, 1});
   std::cout << test_net.activations().at(0) << std::endl;
 
+  // Restored last, as creating genomes advances the restored genome id counter
+  if (resume) {
+    population = Population::restore(checkpoint, &pool);
+    if (population == nullptr) {
+      std::cerr << "Cannot restore " << checkpoint_path << std::endl;
+      return 1;
+    }
+    std::cout << "Resuming from generation " << population->generation()
+              << std::endl;
+  }
+  // The first generation of a resumed run was evaluated and journaled before
+  // its checkpoint was taken
+  bool evaluated = resume && checkpoint.header().fitnesses_size() > 0;
+  CheckpointWriter writer;
+  std::unique_ptr<JournalWriter> journal;
+  if (argc > 4 && argv[4][0] != '\0') {
+    journal.reset(new JournalWriter(argv[4]));
+  }
+  std::ofstream stats_output;
+  bool stats_json = false;
+  if (argc > 5 && argv[5][0] != '\0') {
+    std::string path = argv[5];
+    stats_json = path.size() >= 5 && path.substr(path.size() - 5) == ".json";
+    stats_output.open(path);
+    if (!stats_output) {
+      std::cerr << "Cannot open " << path << std::endl;
+      return 1;
+    }
+    if (!stats_json) {
+      stats_output << stats::GenerationStats::csv_header() << std::endl;
+    }
+  }
+  stats::Recorder recorder;
+  std::string trace_path = argc > 6 ? argv[6] : "";
+  if (!trace_path.empty()) {
+    trace::start();
+  }
+
   int generations = 1000;
-  for (int i = 0; i < generations; i++) {
-    std::shared_ptr<Genome> best_in_gen;
-    double max_fitness = -10000;
-    for (const auto& genome : population.genomes_) {
-      double fitness = 0;
-      Network network{*genome};
-      for (const auto& test : tests) {
-        network.activate({test.first.first, test.first.second});
-        fitness += std::abs(test.second - network.activations().at(0));
+  for (int i = population->generation() - 1; i < generations; i++) {
+    TRACE_SPAN("generation", population->generation());
+    if (evaluated) {
+      evaluated = false;
+    } else {
+      if (fleet == nullptr) {
+        evaluate(*population, evaluator, pool);
+      } else if (!fleet->evaluate(*population)) {
+        std::cerr << fleet->error() << std::endl;
+        return 1;
       }
-      fitness = 4 - fitness;
-      fitness *= fitness;
-      population.g_fitnesses_[genome] = fitness;
+      if (journal != nullptr) {
+        journal->append(*population);
+      }
+      if (!checkpoint_path.empty() &&
+          population->generation() % kCheckpointInterval == 0) {
+        writer.write(*population, checkpoint_path);
+      }
+    }
+
+    const Genome* best_in_gen = nullptr;
+    double max_fitness = -10000;
+    for (size_t j = 0; j < population->genomes_.size(); j++) {
+      double fitness = population->fitnesses_.at(j);
       if (fitness > max_fitness) {
         max_fitness = fitness;
-        best_in_gen = genome;
+        best_in_gen = population->genomes_.at(j);
       }
     }
-    std::cout << "Gen " << population.generation() << ": " << max_fitness
-              << "\t\tNum species: " << population.species_size()
+    std::cout << "Gen " << population->generation() << ": " << max_fitness
+              << "\t\tNum species: " << population->species_size()
               << "\t\tBest in gen: " << best_in_gen->id() << std::endl;
     if (true && i == generations - 1) {
       std::cout << best_in_gen->DebugString() << std::endl;
     }
     if (false && i == 99) {
-      for (const auto& fitness : population.g_fitnesses_) {
-        std::cout << fitness.first->id() << "\t\t" << fitness.second
-                  << std::endl;
+      for (size_t j = 0; j < population->genomes_.size(); j++) {
+        std::cout << population->genomes_.at(j)->id() << "\t\t"
+                  << population->fitnesses_.at(j) << std::endl;
       }
     }
-    population = population.reproduce();
+    *population = population->reproduce();
+    if (stats_output.is_open()) {
+      auto generation_stats = recorder.next(population->generation() - 1);
+      stats_output << (stats_json ? generation_stats.json()
+                                  : generation_stats.csv())
+                   << "\n";
+    }
+  }
+  report_precision(evaluator, *population);
+  if (!writer.flush()) {
+    std::cerr << writer.error() << std::endl;
+    return 1;
+  }
+  if (!trace_path.empty()) {
+    trace::stop();
+    if (!trace::write(trace_path)) {
+      std::cerr << "Cannot write " << trace_path << std::endl;
+      return 1;
+    }
+  }
+  if (journal != nullptr && !journal->close()) {
+    std::cerr << journal->error() << std::endl;
+    return 1;
   }
 }
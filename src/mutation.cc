@@ -1,14 +1,14 @@
 #include "neat_lstm/mutation.h"
 
-#include <google/protobuf/repeated_field.h>
 #include <algorithm>
 #include <cassert>
 #include <iostream>
-#include <memory>
-#include <unordered_set>
 #include <vector>
 
+#include "macros/stats.h"
 #include "neat_lstm/config_store.h"
+#include "neat_lstm/genome_builder.h"
+#include "neat_lstm/genome_delta.h"
 #include "neat_lstm/innovation.h"
 #include "neat_lstm/utils/genome_utils.h"
 #include "neat_lstm/utils/math.h"
@@ -17,129 +17,58 @@
 #include "proto/structures.pb.h"
 
 namespace mutation {
-namespace {
 
-using google::protobuf::RepeatedPtrField;
-
-// Comparison fnctor for connections based on innovation numbers.
-// TODO: Consider moving to utils.
-class InnovationComparator {
- public:
-  InnovationComparator(bool reversed = false) : reversed_(reversed) {}
-
-  bool operator()(const std::unique_ptr<Connection>& a,
-                  const std::unique_ptr<Connection>& b) {
-    return reversed_ ? a->innovation() > b->innovation()
-                     : a->innovation() < b->innovation();
-  }
-
- private:
-  bool reversed_ = false;
-};
-
-// Inserts a node to the genome's node list at the specified index, transfering
-// ownership of the node.
-void insert_node(Genome& genome, Node* node, int index) {
-  assert(index >= 0 && index < genome.nodes_size());
-  int cur_index = genome.nodes_size() - 1;
-  genome.mutable_nodes()->AddAllocated(node);
-  for (; cur_index >= index; cur_index--) {
-    assert(cur_index >= 0 && cur_index < genome.nodes_size());
-    genome.mutable_nodes()->SwapElements(cur_index, cur_index + 1);
-  }
-}
-
-// Inserts a node to the genome's node list to precede the node with the target
-// id, transfering ownership of the node.
-void insert_node_target_id(Genome& genome, std::unique_ptr<Node> node, int id) {
-  int cur_index = genome.nodes_size() - 1;
-  genome.mutable_nodes()->AddAllocated(node.release());
-  for (; genome.nodes(cur_index).id() != id; cur_index--) {
-    assert(cur_index >= 0 && cur_index < genome.nodes_size());
-    genome.mutable_nodes()->SwapElements(cur_index, cur_index + 1);
-  }
-  assert(cur_index >= 0 && cur_index < genome.nodes_size());
-  genome.mutable_nodes()->SwapElements(cur_index, cur_index + 1);
-}
-
-// Insert new connections to the genome in a way that connections are sorted by
-// ascending innovation numbers. The input vector is invalidated after the
-// insertion.
-void insert_connections(Genome& genome,
-                        std::vector<std::unique_ptr<Connection>> connections) {
-  // Min-heap based on innovation numbers
-  auto comparator = InnovationComparator(true);
-  std::make_heap(connections.begin(), connections.end(), comparator);
-  RepeatedPtrField<Connection> new_connections;
-
-  for (auto& existing_connection : *genome.mutable_connections()) {
-    if (connections.size() > 0 &&
-        connections.front()->innovation() < existing_connection.innovation()) {
-      std::pop_heap(connections.begin(), connections.end(), comparator);
-      new_connections.AddAllocated(connections.back().release());
-      connections.pop_back();
-    }
-    auto* new_connection = new_connections.Add();
-    std::swap(*new_connection, existing_connection);
-  }
-  // Add excess connections
-  while (connections.size() > 0) {
-    std::pop_heap(connections.begin(), connections.end(), comparator);
-    new_connections.AddAllocated(connections.back().release());
-    connections.pop_back();
-  }
-
-  genome.mutable_connections()->Swap(&new_connections);
-}
-
-}  // namespace
-
-void mutate_all(Genome& source) {
+void mutate_all(Genome& source, GenomeDelta* delta) {
+  STATS_TIMER(stats::kMutation);
+  // Structural mutations share a builder, so its indexes are built at most
+  // once and the genome's lists are rewritten once
+  GenomeBuilder builder{&source};
   if (utils::random::uniform(0, 1) < ConfigStore::mutation().p_add_node()) {
-    add_node(source);
+    add_node(builder, delta);
   }
   if (utils::random::uniform(0, 1) <
       ConfigStore::mutation().p_add_connection()) {
-    add_connection(source);
+    add_connection(builder, delta);
   }
   if (utils::random::uniform(0, 1) <
       ConfigStore::mutation().p_toggle_connection()) {
-    toggle_connection(source);
+    toggle_connection(builder, delta);
   }
+  builder.build();
   if (utils::random::uniform(0, 1) <
       ConfigStore::mutation().p_perturb_weights()) {
-    perturb_weights(source);
+    perturb_weights(source, delta);
   }
 }
 
-void add_connection(Genome& source) {
-  // Prepare set of innovation numbers in source
-  std::unordered_set<int> innovations;
-  for (const auto& connection : source.connections()) {
-    innovations.insert(connection.innovation());
-  }
+void add_connection(Genome& source, GenomeDelta* delta) {
+  GenomeBuilder builder{&source};
+  add_connection(builder, delta);
+}
 
+void add_connection(GenomeBuilder& builder, GenomeDelta* delta) {
   // Only create forward connections
-  int start_node_index = utils::random::uniform_int(0, source.nodes_size() - 2);
+  const int size = builder.node_count();
+  int start_node_index = utils::random::uniform_int(0, size - 2);
   int end_node_index =
-      utils::random::uniform_int(start_node_index + 1, source.nodes_size() - 1);
+      utils::random::uniform_int(start_node_index + 1, size - 1);
 
-  while (source.nodes(end_node_index).type() == Node::INPUT ||
-         source.nodes(end_node_index).type() == Node::BIAS) {
+  while (builder.node(end_node_index).type() == Node::INPUT ||
+         builder.node(end_node_index).type() == Node::BIAS) {
     end_node_index++;
   }
-  while (source.nodes(start_node_index).type() == Node::OUTPUT ||
-         source.nodes(start_node_index).type() == Node::BIAS) {
+  while (builder.node(start_node_index).type() == Node::OUTPUT ||
+         builder.node(start_node_index).type() == Node::BIAS) {
     start_node_index--;
   }
 
-  int start_id = source.nodes(start_node_index).id();
-  int end_id = source.nodes(end_node_index).id();
+  int start_id = builder.node(start_node_index).id();
+  int end_id = builder.node(end_node_index).id();
   int innovation = Innovation::get(start_id, end_id);
 
   // Found a new innovation
-  if (innovations.find(innovation) == innovations.end()) {
-    auto connection = std::make_unique<Connection>();
+  if (!builder.has_connection(start_id, end_id)) {
+    Connection* connection = builder.new_connection();
     connection->set_innovation(innovation);
     connection->set_enabled(true);
     connection->set_in_node(start_id);
@@ -147,48 +76,60 @@ void add_connection(Genome& source) {
     connection->set_weight(
         utils::random::uniform(ConfigStore::bounds().min_weight(),
                                ConfigStore::bounds().max_weight()));
-
-    std::vector<std::unique_ptr<Connection>> new_connections;
-    new_connections.push_back(std::move(connection));
-    insert_connections(source, std::move(new_connections));
+    int position = builder.insert_connection(connection);
+    if (delta != nullptr) {
+      delta->structure_changed(GenomeDelta::Type::kConnectionAdded, position);
+    }
+    STATS_COUNT(stats::kStructuralMutations, 1);
   }
 }
 
-void add_node(Genome& source) {
-  int old_index = utils::random::uniform_int(0, source.connections_size() - 1);
+void add_node(Genome& source, GenomeDelta* delta) {
+  GenomeBuilder builder{&source};
+  add_node(builder, delta);
+}
+
+void add_node(GenomeBuilder& builder, GenomeDelta* delta) {
+  Genome& source = builder.genome();
+  const int size = builder.connection_count();
+  int old_index = utils::random::uniform_int(0, size - 1);
   // If source is the bias node, look for another connection
-  while (utils::node_type(source, source.connections(old_index).in_node()) ==
+  while (utils::node_type(source, builder.connection(old_index)->in_node()) ==
          Node::BIAS) {
-    old_index = utils::random::uniform_int(0, source.connections_size() - 1);
+    old_index = utils::random::uniform_int(0, size - 1);
   }
-  int source_id = source.connections(old_index).in_node();
-  int target_id = source.connections(old_index).out_node();
+  Connection* old_connection = builder.connection(old_index);
+  int source_id = old_connection->in_node();
+  int target_id = old_connection->out_node();
 
   // Disable old connection
-  source.mutable_connections(old_index)->set_enabled(false);
+  old_connection->set_enabled(false);
+  if (delta != nullptr) {
+    delta->structure_changed(GenomeDelta::Type::kConnectionToggled, old_index);
+  }
 
   // Allocate new node with SIGMOID activation
-  auto new_node = std::make_unique<Node>();
+  Node* new_node = builder.new_node();
   new_node->set_type(Node::HIDDEN);
   new_node->set_activation_type(ActivationType::SIGMOID);
   new_node->set_id(source.max_node_id() + 1);
   source.set_max_node_id(new_node->id());
 
   // Create 2 new connections
-  auto c_1 = std::make_unique<Connection>();
+  Connection* c_1 = builder.new_connection();
   c_1->set_enabled(true);
   c_1->set_in_node(source_id);
   c_1->set_out_node(new_node->id());
   c_1->set_weight(1);
   c_1->set_innovation(Innovation::get(source_id, new_node->id()));
-  auto c_2 = std::make_unique<Connection>();
+  Connection* c_2 = builder.new_connection();
   c_2->set_enabled(true);
   c_2->set_in_node(new_node->id());
   c_2->set_out_node(target_id);
-  c_2->set_weight(source.connections(old_index).weight());
+  c_2->set_weight(old_connection->weight());
   c_2->set_innovation(Innovation::get(new_node->id(), target_id));
   // Create connection from bias to new node
-  auto c_3 = std::make_unique<Connection>();
+  Connection* c_3 = builder.new_connection();
   int bias_id = utils::bias_id(source);
   c_3->set_enabled(true);
   c_3->set_in_node(bias_id);
@@ -198,46 +139,69 @@ void add_node(Genome& source) {
 
   // Insert new node right before old target node (to maintain topological
   // order)
-  insert_node_target_id(source, std::move(new_node), target_id);
+  int node_index = builder.insert_node(new_node, target_id);
+  if (delta != nullptr) {
+    delta->structure_changed(GenomeDelta::Type::kNodeInserted, node_index);
+  }
 
   // Insert new connections
-  std::vector<std::unique_ptr<Connection>> new_connections;
-  new_connections.push_back(std::move(c_1));
-  new_connections.push_back(std::move(c_2));
-  new_connections.push_back(std::move(c_3));
-  insert_connections(source, std::move(new_connections));
+  for (Connection* connection : {c_1, c_2, c_3}) {
+    int position = builder.insert_connection(connection);
+    if (delta != nullptr) {
+      delta->structure_changed(GenomeDelta::Type::kConnectionAdded, position);
+    }
+  }
+  STATS_COUNT(stats::kStructuralMutations, 1);
 }
 
-void toggle_connection(Genome& source) {
-  int index = utils::random::uniform_int(0, source.connections_size());
-  Connection* connection = source.mutable_connections(index);
+void toggle_connection(Genome& source, GenomeDelta* delta) {
+  GenomeBuilder builder{&source};
+  toggle_connection(builder, delta);
+}
+
+void toggle_connection(GenomeBuilder& builder, GenomeDelta* delta) {
+  int index = utils::random::uniform_int(0, builder.connection_count() - 1);
+  Connection* connection = builder.connection(index);
   connection->set_enabled(!connection->enabled());
+  if (delta != nullptr) {
+    delta->structure_changed(GenomeDelta::Type::kConnectionToggled, index);
+  }
 }
 
-void perturb_weights(Genome& source) {
-  for (auto& connection : *source.mutable_connections()) {
-    if (ConfigStore::mutation().p_randomize_weight()) {
-      connection.set_weight(
-          utils::random::uniform(ConfigStore::bounds().min_weight(),
-                                 ConfigStore::bounds().max_weight()));
+void perturb_weights(Genome& source, GenomeDelta* delta) {
+  const auto& mutation = ConfigStore::mutation();
+  const auto& bounds = ConfigStore::bounds();
+
+  // Draw a decision and a value for every connection at once
+  int size = source.connections_size();
+  thread_local std::vector<double> draws;
+  draws.resize(2 * size);
+  utils::random::uniform(draws.data(), draws.size(), 0, 1);
+
+  for (int i = 0; i < size; i++) {
+    Connection* connection = source.mutable_connections(i);
+    double value = draws[2 * i + 1];
+    if (draws[2 * i] < mutation.p_randomize_weight()) {
+      connection->set_weight(bounds.min_weight() +
+                             (bounds.max_weight() - bounds.min_weight()) *
+                                 value);
     } else {
-      connection.set_weight(utils::math::clamp(
-          utils::random::uniform(
-              connection.weight() -
-                  ConfigStore::mutation().perturb_weight_power(),
-              connection.weight() +
-                  ConfigStore::mutation().perturb_weight_power()),
-          ConfigStore::bounds().min_weight(),
-          ConfigStore::bounds().max_weight()));
+      double weight = connection->weight() +
+                      (2 * value - 1) * mutation.perturb_weight_power();
+      connection->set_weight(utils::math::clamp(weight, bounds.min_weight(),
+                                                bounds.max_weight()));
+    }
+    if (delta != nullptr) {
+      delta->weight_changed(i);
     }
   }
 }
 
-void add_lstm_unit(Genome& source) {
+void add_lstm_unit(Genome& source, GenomeDelta* /*delta*/) {
   // TODO: Implement
 }
 
-void expand_lstm_state(Genome& source) {
+void expand_lstm_state(Genome& source, GenomeDelta* /*delta*/) {
   // TODO: Implement
 }
 
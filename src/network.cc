@@ -3,11 +3,13 @@
 #include <vector>
 
 #include "macros/assert.h"
+#include "macros/stats.h"
 #include "neat_lstm/activation.h"
 #include "neat_lstm/network.h"
 #include "proto/structures.pb.h"
 
 Network::Network(const Genome& genome) : genome(genome) {
+  STATS_COUNT(stats::kNetworksBuilt, 1);
   // Construct map of node genes from genome and reserve input and output nodes
   for (const auto& node : genome.nodes()) {
     node_genes_.insert({node.id(), NodeGene{&node}});
@@ -33,7 +35,7 @@ Network::Network(const Genome& genome) : genome(genome) {
   for (const auto& connection : genome.connections()) {
     int node_id = connection.out_node();
     if (in_connections_.find(node_id) != in_connections_.end()) {
-      in_connections_.at(node_id).insert(&connection);
+      in_connections_.at(node_id).push_back(&connection);
     } else {
       in_connections_.insert({node_id, {&connection}});
     }
@@ -56,8 +58,6 @@ void Network::activate(const std::vector<double>& inputs) {
   // Input size must match genome schema
   assert(genome.input_size() == inputs.size());
 
-  auto activation_map = activation::get_activation_map();
-
   std::vector<double> outputs;
 
   // Load input nodes
@@ -102,16 +102,12 @@ void Network::activate(const std::vector<double>& inputs) {
     }
 
     // Make sure activation type is defined
-    if (activation_map.find(node_gene->activation_type()) ==
-        activation_map.end()) {
-    }
-    ASSERT(activation_map.find(node_gene->activation_type()) !=
-               activation_map.end(),
+    ASSERT(activation::is_defined(node_gene->activation_type()),
            "Index %d, Node type: %d, Activation type: %d\n", i,
            node_gene->type(), node_gene->activation_type());
 
-    node_gene->activation = (*activation_map.at(node_gene->activation_type()))(
-        weighted_sum + weighted_bias);
+    node_gene->activation = activation::activate(
+        node_gene->activation_type(), weighted_sum + weighted_bias);
   }
 }
 
@@ -123,6 +119,16 @@ std::vector<double> Network::activations() const {
   return activations;
 }
 
+void Network::reset_state() {
+  for (auto& node_gene : node_genes_) {
+    node_gene.second.activation =
+        node_gene.second.type() == Node::BIAS ? 1 : 0;
+  }
+  for (auto& lstm_unit_gene : lstm_unit_genes_) {
+    lstm_unit_gene.reset();
+  }
+}
+
 NodeGene* Network::mutable_node_gene_by_id(int id) {
   return &node_genes_.at(id);
 }
@@ -0,0 +1,21 @@
+#include "neat_lstm/network_pool.h"
+
+#include "neat_lstm/activation.h"
+#include "neat_lstm/compiled_network.h"
+#include "proto/structures.pb.h"
+
+template <typename Scalar>
+CompiledNetwork<Scalar>& NetworkPool<Scalar>::acquire(const Genome& genome,
+                                                      activation::Mode mode) {
+  network_.rebuild(genome, mode);
+  return network_;
+}
+
+template <typename Scalar>
+NetworkPool<Scalar>& NetworkPool<Scalar>::local() {
+  static thread_local NetworkPool pool;
+  return pool;
+}
+
+template class NetworkPool<float>;
+template class NetworkPool<double>;
@@ -1,90 +1,326 @@
 #include "neat_lstm/population.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <numeric>
 
 #include "macros/assert.h"
+#include "macros/stats.h"
+#include "macros/trace.h"
+#include "neat_lstm/checkpoint.h"
+#include "neat_lstm/config_store.h"
+#include "neat_lstm/innovation.h"
+#include "neat_lstm/island.h"
 #include "neat_lstm/mutation.h"
 #include "neat_lstm/network.h"
+#include "neat_lstm/reproduction.h"
+#include "neat_lstm/selection.h"
+#include "neat_lstm/thread_pool.h"
 #include "neat_lstm/utils/genome_utils.h"
 #include "neat_lstm/utils/random.h"
 #include "proto/structures.pb.h"
 
-Population::Population(const Genome& seed, size_t size) : size_(size) {
+namespace {
+
+// Stream id for draws of a generation that are not tied to a genome. Genome
+// ids never reach it. Islands use the ids below it, one each.
+const uint64_t kPopulationStream = 0xFFFFFFFF;
+
+// Number of generations between pruning of unreferenced innovation numbers
+const int kInnovationPruneInterval = 32;
+
+// Assigns final innovation numbers to the connections first seen in this
+// generation, and periodically forgets innovations no genome refers to.
+void commit_innovations(InnovationRegistry& registry,
+                        const std::vector<Genome*>& genomes, int generation) {
+  registry.commit();
+  for (Genome* genome : genomes) {
+    registry.renumber(*genome);
+  }
+
+  if (generation % kInnovationPruneInterval == 0) {
+    registry.prune(std::vector<const Genome*>(genomes.begin(), genomes.end()));
+  }
+}
+
+// Number of genomes handled by a task of for_each_block()
+const size_t kBlockSize = 64;
+
+// Runs task(i) for every i in [0, count) on the pool, in blocks of genomes, or
+// on the calling thread if there is no pool.
+void for_each_block(ThreadPool* pool, size_t count,
+                    const std::function<void(size_t)>& task) {
+  if (pool == nullptr) {
+    for (size_t i = 0; i < count; i++) {
+      task(i);
+    }
+    return;
+  }
+
+  size_t blocks = (count + kBlockSize - 1) / kBlockSize;
+  pool->parallel_for(blocks,
+                     [count, &task](size_t block, size_t /*worker*/) {
+                       size_t end = std::min(count, (block + 1) * kBlockSize);
+                       for (size_t i = block * kBlockSize; i < end; i++) {
+                         task(i);
+                       }
+                     });
+}
+
+// Produces the offspring of a mating on the arena. New offspring draw from
+// their own stream of the generation.
+Genome* breed(const std::vector<Genome*>& genomes,
+              const selection::Mating& mating, int id, int generation,
+              GenomeArena& arena) {
+  TRACE_SPAN("breed", id);
+  const Genome& parent = *genomes.at(mating.parent_a);
+  if (mating.op == selection::Operator::kCopy) {
+    return arena.copy(parent);
+  }
+
+  utils::random::ScopedStream stream{(uint64_t)generation, (uint64_t)id};
+  Genome* child;
+  if (mating.op == selection::Operator::kCrossover) {
+    child = arena.create();
+    reproduction::crossover(parent, *genomes.at(mating.parent_b), child);
+  } else {
+    child = arena.copy(parent);
+  }
+  child->set_id(id);
+  mutation::mutate_all(*child);
+  return child;
+}
+
+}  // namespace
+
+Population::Population(const Genome& seed, size_t size,
+                       ThreadPool* thread_pool,
+                       std::shared_ptr<const selection::Selector> selector,
+                       Island* island)
+    : size_(size),
+      thread_pool_(thread_pool),
+      selector_(selector ? selector
+                         : selection::create(ConfigStore::reproduction())),
+      island_(island),
+      arena_(GenomeArena::acquire()) {
+  ScopedRegistry scope{registry()};
   // Generate mutations of seed as organisms and initialize fitnesses
-  for (int i = 0; i < size; i++) {
-    Genome genome = seed;
-    genome.set_id(utils::genome_id++);
-    mutation::mutate_all(genome);
-    auto organism = std::make_shared<Genome>(genome);
+  for (size_t i = 0; i < size; i++) {
+    Genome* organism = arena_->copy(seed);
+    organism->set_id(next_genome_id());
+    // The seed is numbered by the process-wide registry
+    if (island_ != nullptr) {
+      island_->registry().adopt(*organism);
+    }
+    utils::random::ScopedStream stream{(uint64_t)generation_,
+                                       (uint64_t)organism->id()};
+    mutation::mutate_all(*organism);
     genomes_.push_back(organism);
   }
+  commit_innovations(registry(), genomes_, generation_);
 
   // Initial speciation
   speciate();
 }
 
+std::unique_ptr<Population> Population::restore(
+    const CheckpointReader& checkpoint, ThreadPool* thread_pool,
+    std::shared_ptr<const selection::Selector> selector) {
+  checkpoint.restore_globals();
+  const CheckpointHeader& header = checkpoint.header();
+
+  std::unique_ptr<Population> population(new Population());
+  population->generation_ = header.generation();
+  population->size_ = checkpoint.genome_count();
+  population->thread_pool_ = thread_pool;
+  population->selector_ =
+      selector ? selector : selection::create(ConfigStore::reproduction());
+  population->arena_ = GenomeArena::acquire();
+
+  const size_t size = population->size_;
+  auto& genomes = population->genomes_;
+  genomes.resize(size);
+  std::atomic<bool> valid{true};
+  GenomeArena& arena = *population->arena_;
+  for_each_block(thread_pool, size, [&](size_t i) {
+    genomes.at(i) = arena.create();
+    if (!checkpoint.genome(i, genomes.at(i))) {
+      valid = false;
+    }
+  });
+  if (!valid) {
+    return nullptr;
+  }
+
+  // Species are stored as ranges of the genomes
+  population->species_ids_.resize(size);
+  size_t begin = 0;
+  for (uint64_t end : header.species_ends()) {
+    std::fill(population->species_ids_.begin() + begin,
+              population->species_ids_.begin() + end,
+              population->species_.size());
+    population->species_.emplace_back(begin, end);
+    begin = end;
+  }
+  if (header.fitnesses_size() == (int)size) {
+    population->fitnesses_.assign(header.fitnesses().begin(),
+                                  header.fitnesses().end());
+  } else {
+    population->fitnesses_.assign(size, 0);
+  }
+  population->parents_.resize(size);
+  return population;
+}
+
 void Population::speciate() {
-  for (const auto& genome : genomes_) {
-    // Check all species, measuring compatibilities
-    bool species_found = false;
-    for (const auto& s : species_) {
-      if (s->compatible(*genome)) {
-        s->add_genome(genome);
-        species_found = true;
-        break;
-      }
+  STATS_TIMER(stats::kSpeciation);
+  TRACE_SPAN("speciate");
+  const double threshold = ConfigStore::speciation().compatibility_threshold();
+  const size_t size = genomes_.size();
+
+  std::vector<utils::FlatConnections> connections(size);
+  for_each_block(thread_pool_, size, [this, &connections](size_t i) {
+    connections.at(i) = utils::FlatConnections(*genomes_.at(i));
+  });
+
+  // Representatives of the species created so far, in species order
+  std::vector<const utils::FlatConnections*> representatives;
+
+  // Index of the first compatible species of each genome, among the first
+  // scored[i] species
+  std::vector<int> matches(size, -1);
+  std::vector<size_t> scored(size, 0);
+  std::vector<size_t> species_ids(size);
+
+  for (size_t next = 0; next < size; next++) {
+    // Score the remaining genomes against species created since they were
+    // last scored
+    if (scored.at(next) < representatives.size()) {
+      const size_t count = representatives.size();
+      for_each_block(thread_pool_, size - next, [&, next, count](size_t k) {
+        size_t i = next + k;
+        if (matches.at(i) < 0 && scored.at(i) < count) {
+          matches.at(i) =
+              utils::first_compatible(connections.at(i), representatives,
+                                      scored.at(i), count, threshold);
+          scored.at(i) = count;
+        }
+      });
     }
+
     // If not compatible with any species, create a new one
-    if (!species_found) {
-      species_.push_back(std::make_shared<Species>(genome));
+    if (matches.at(next) >= 0) {
+      species_ids.at(next) = matches.at(next);
+    } else {
+      species_ids.at(next) = representatives.size();
+      representatives.push_back(&connections.at(next));
     }
   }
+
+  // Lay out species contiguously with a stable counting sort
+  std::vector<size_t> offsets(representatives.size() + 1, 0);
+  for (size_t id : species_ids) {
+    offsets.at(id + 1)++;
+  }
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  species_.clear();
+  species_.reserve(representatives.size());
+  for (size_t s = 0; s < representatives.size(); s++) {
+    species_.emplace_back(offsets.at(s), offsets.at(s + 1));
+  }
+
+  fitnesses_.resize(size, 0);
+  parents_.resize(size);
+  std::vector<Genome*> genomes(size);
+  std::vector<double> fitnesses(size);
+  std::vector<Parents> parents(size);
+  species_ids_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    size_t index = offsets.at(species_ids.at(i))++;
+    genomes.at(index) = genomes_.at(i);
+    fitnesses.at(index) = fitnesses_.at(i);
+    parents.at(index) = parents_.at(i);
+    species_ids_.at(index) = species_ids.at(i);
+  }
+  genomes_.swap(genomes);
+  fitnesses_.swap(fitnesses);
+  parents_.swap(parents);
 }
 
 Population Population::reproduce() {
+  STATS_TIMER(stats::kReproduction);
+  TRACE_SPAN("reproduce", generation_);
   Population population;
   population.generation_ = generation_ + 1;
-  population.size_ = 0;
+  population.thread_pool_ = thread_pool_;
+  population.selector_ = selector_;
+  population.island_ = island_;
+  population.arena_ = GenomeArena::acquire();
+
+  // Draws not tied to a single offspring come from the population's stream
+  const uint64_t stream_id =
+      kPopulationStream - (island_ != nullptr ? island_->index() + 1 : 0);
+  utils::random::ScopedStream stream{(uint64_t)population.generation_,
+                                     stream_id};
 
   // Calculate adjusted fitnesses to allocate offspring numbers of species
-  double total_adjusted_fitness = 0;
-  std::unordered_map<std::shared_ptr<Species>, double> species_fitnesses;
-  for (const auto& s : species_) {
-    species_fitnesses[s] = 0;
-    for (const auto& genome : s->genomes()) {
-      double adjusted_fitness = g_fitnesses_.at(genome) / s->size();
-      species_fitnesses.at(s) += adjusted_fitness;
-      total_adjusted_fitness += adjusted_fitness;
-    }
+  std::vector<double> species_fitnesses(species_.size(), 0);
+  adjusted_fitnesses_.resize(genomes_.size());
+  for (size_t i = 0; i < genomes_.size(); i++) {
+    size_t id = species_ids_.at(i);
+    adjusted_fitnesses_.at(i) = fitnesses_.at(i) / species_.at(id).size();
+    species_fitnesses.at(id) += adjusted_fitnesses_.at(i);
   }
 
-  // Generate offspring from species based on adjusted fitnesses
-  for (const auto& s : species_) {
-    auto offspring = s->reproduce(
-        g_fitnesses_,
-        std::round(species_fitnesses.at(s) / total_adjusted_fitness * size_));
-    // TODO: Keep some previous species based on staleness, currently we
-    // re-speciate at each generation
-
-    // Make sure we don't exceed size of population
-    size_t num_offspring = std::min(offspring.size(), size_ - population.size_);
-    population.genomes_.insert(population.genomes_.end(), offspring.begin(),
-                               offspring.begin() + num_offspring);
-    population.size_ += num_offspring;
+  // Allocate offspring to species and plan their matings
+  std::vector<size_t> counts;
+  std::vector<selection::Mating> plan;
+  {
+    STATS_TIMER(stats::kSelection);
+    selection::allocate_offspring(species_fitnesses, size_, &counts);
+    plan.reserve(size_);
+    for (size_t s = 0; s < species_.size(); s++) {
+      TRACE_SPAN("plan_species", s);
+      selector_->plan(fitnesses_, species_.at(s).begin(), species_.at(s).end(),
+                      counts.at(s), &plan);
+    }
   }
+  // TODO: Keep some previous species based on staleness, currently we
+  // re-speciate at each generation
+  ASSERT(plan.size() == size_, "Specified: %zu, Actual: %zu\n", size_,
+         plan.size());
 
-  // Fill out remaining spaces with random genomes from current generation
-  while (population.size_ < size_) {
-    population.genomes_.push_back(
-        genomes_.at(utils::random::uniform_int(0, size_ - 1)));
-    population.size_++;
+  // New ids are assigned in plan order, so offspring can be bred in parallel
+  std::vector<int> ids(plan.size());
+  population.parents_.resize(plan.size());
+  for (size_t k = 0; k < plan.size(); k++) {
+    const selection::Mating& mating = plan.at(k);
+    ids.at(k) = mating.op == selection::Operator::kCopy
+                    ? genomes_.at(mating.parent_a)->id()
+                    : next_genome_id();
+    population.parents_.at(k).first = genomes_.at(mating.parent_a)->id();
+    if (mating.op == selection::Operator::kCrossover) {
+      population.parents_.at(k).second = genomes_.at(mating.parent_b)->id();
+    }
   }
-  ASSERT(population.size_ == size_, "Specified: %zu, Actual: %zu\n", size_,
-         population.size_);
+  population.genomes_.resize(plan.size());
+  population.size_ = size_;
+  InnovationRegistry& innovations = registry();
+  for_each_block(thread_pool_, plan.size(), [&](size_t k) {
+    ScopedRegistry scope{innovations};
+    population.genomes_.at(k) = breed(genomes_, plan.at(k), ids.at(k),
+                                      population.generation_,
+                                      *population.arena_);
+  });
+  commit_innovations(innovations, population.genomes_,
+                     population.generation_);
+  STATS_COUNT(stats::kBytesAllocated, population.arena_->space_allocated());
 
   population.speciate();
 
@@ -93,4 +329,33 @@ Population Population::reproduce() {
 
 int Population::generation() const { return generation_; }
 
+Genome* Population::replace(size_t index, const Genome& genome,
+                            double fitness) {
+  Genome* copy = arena_->copy(genome);
+  genomes_.at(index) = copy;
+  fitnesses_.at(index) = fitness;
+  parents_.at(index) = Parents();
+  return copy;
+}
+
+int Population::next_genome_id() {
+  return island_ != nullptr ? island_->next_genome_id() : utils::genome_id++;
+}
+
+InnovationRegistry& Population::registry() {
+  return island_ != nullptr ? island_->registry() : Innovation::registry();
+}
+
 size_t Population::species_size() const { return species_.size(); }
+
+const std::vector<Species>& Population::species() const { return species_; }
+
+const std::vector<size_t>& Population::species_ids() const {
+  return species_ids_;
+}
+
+const std::vector<double>& Population::adjusted_fitnesses() const {
+  return adjusted_fitnesses_;
+}
+
+const std::vector<Parents>& Population::parents() const { return parents_; }
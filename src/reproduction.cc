@@ -1,5 +1,10 @@
 #include "neat_lstm/reproduction.h"
 
+#include <cstdint>
+#include <vector>
+
+#include "macros/stats.h"
+#include "macros/trace.h"
 #include "neat_lstm/utils/genome_utils.h"
 #include "neat_lstm/utils/random.h"
 #include "proto/structures.pb.h"
@@ -8,7 +13,15 @@ namespace reproduction {
 
 Genome crossover(const Genome& more_fit, const Genome& less_fit) {
   Genome genome;
+  crossover(more_fit, less_fit, &genome);
   genome.set_id(utils::genome_id++);
+  return genome;
+}
+
+void crossover(const Genome& more_fit, const Genome& less_fit, Genome* child) {
+  STATS_COUNT(stats::kCrossovers, 1);
+  TRACE_SPAN("crossover");
+  Genome& genome = *child;
   genome.set_input_size(more_fit.input_size());
   genome.set_output_size(more_fit.output_size());
   genome.set_max_node_id(more_fit.max_node_id());
@@ -16,36 +29,52 @@ Genome crossover(const Genome& more_fit, const Genome& less_fit) {
   // According to NEAT, the genome will have all nodes of the more fit parent.
   genome.mutable_nodes()->CopyFrom(more_fit.nodes());
 
-  // Based on assumption that connections are ordered by innovation number
-  auto mf_it = more_fit.connections().begin();
-  auto lf_it = less_fit.connections().begin();
-  while (mf_it != more_fit.connections().end()) {
-    if (lf_it == less_fit.connections().end() ||
-        mf_it->innovation() < lf_it->innovation()) {
-      // Disjoint or excess on more fit: inherit
-      auto* connection = genome.add_connections();
-      connection->CopyFrom(*mf_it);
-      mf_it++;
-    } else if (mf_it->innovation() == lf_it->innovation()) {
-      // Matching gene: inherit randomly
-      auto* connection = genome.add_connections();
-      if (utils::random::uniform_int(0, 1) == 0) {
-        connection->CopyFrom(*mf_it);
-      } else {
-        connection->CopyFrom(*lf_it);
+  // Based on assumption that connections are ordered by innovation number.
+  // A first merge counts the matching genes, so that their random choices are
+  // drawn at once and the child is sized once.
+  const auto& mf_connections = more_fit.connections();
+  const auto& lf_connections = less_fit.connections();
+  const int mf_size = mf_connections.size();
+  const int lf_size = lf_connections.size();
+  size_t matches = 0;
+  for (int mf = 0, lf = 0; mf < mf_size && lf < lf_size;) {
+    int mf_innovation = mf_connections.Get(mf).innovation();
+    int lf_innovation = lf_connections.Get(lf).innovation();
+    matches += mf_innovation == lf_innovation;
+    mf += mf_innovation <= lf_innovation;
+    lf += lf_innovation <= mf_innovation;
+  }
+
+  // The top bit of each draw decides a matching gene like uniform_int(0, 1)
+  thread_local std::vector<uint64_t> draws;
+  draws.resize(matches);
+  utils::random::next(draws.data(), matches);
+
+  // The child inherits every gene of the more fit parent: disjoint and excess
+  // genes from it, and matching genes from either parent at random. Genes
+  // disjoint on the less fit parent are ignored.
+  auto* connections = genome.mutable_connections();
+  connections->Reserve(mf_size);
+  size_t match = 0;
+  for (int mf = 0, lf = 0; mf < mf_size; mf++) {
+    const Connection& mf_connection = mf_connections.Get(mf);
+    while (lf < lf_size &&
+           lf_connections.Get(lf).innovation() < mf_connection.innovation()) {
+      lf++;
+    }
+    const Connection* source = &mf_connection;
+    if (lf < lf_size &&
+        lf_connections.Get(lf).innovation() == mf_connection.innovation()) {
+      if (draws[match++] >> 63) {
+        source = &lf_connections.Get(lf);
       }
-      mf_it++;
-      lf_it++;
-    } else {
-      // Disjoint on less fit: ignore
-      lf_it++;
+      lf++;
     }
+    *connections->Add() = *source;
   }
 
   // TODO: Proper LSTM crossover
   genome.mutable_lstm_units()->CopyFrom(more_fit.lstm_units());
-
-  return genome;
 }
 
 }  // namespace reproduction
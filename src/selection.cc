@@ -0,0 +1,244 @@
+#include "neat_lstm/selection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "macros/assert.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/config.pb.h"
+
+namespace selection {
+
+namespace {
+
+// Orders indices by descending value, breaking ties by the lower index so
+// that results do not depend on the order of a partial sort.
+class Descending {
+ public:
+  explicit Descending(const std::vector<double>& values) : values_(values) {}
+
+  bool operator()(size_t a, size_t b) const {
+    return values_[a] > values_[b] || (values_[a] == values_[b] && a < b);
+  }
+
+ private:
+  const std::vector<double>& values_;
+};
+
+// Returns the fittest of the genomes [begin, end).
+size_t fittest(const std::vector<double>& fitnesses, size_t begin,
+               size_t end) {
+  Descending fitter(fitnesses);
+  size_t best = begin;
+  for (size_t i = begin + 1; i < end; i++) {
+    if (fitter(i, best)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Appends the offspring of 2 parents, which is a mutated copy if they are the
+// same genome.
+void mate(const std::vector<double>& fitnesses, size_t a, size_t b,
+          std::vector<Mating>* plan) {
+  if (a == b) {
+    plan->push_back({a, a, Operator::kMutate});
+  } else if (Descending(fitnesses)(a, b)) {
+    plan->push_back({a, b, Operator::kCrossover});
+  } else {
+    plan->push_back({b, a, Operator::kCrossover});
+  }
+}
+
+// Appends count mutated copies of the genome.
+void clone(size_t genome, size_t count, std::vector<Mating>* plan) {
+  for (size_t i = 0; i < count; i++) {
+    plan->push_back({genome, genome, Operator::kMutate});
+  }
+}
+
+}  // namespace
+
+void TruncationSelector::plan(const std::vector<double>& fitnesses,
+                              size_t begin, size_t end, size_t count,
+                              std::vector<Mating>* plan) const {
+  const size_t size = end - begin;
+  if (count == 0) {
+    return;
+  } else if (size == 1) {
+    clone(begin, count, plan);
+    return;
+  }
+
+  // Crossing over all pairs of x survivors yields x * (x - 1) / 2 offspring,
+  // so x = ceil(sqrt(2 * count)) survivors suffice to fill count places
+  const size_t survivors =
+      std::min((size_t)std::ceil(std::sqrt(2.0 * count)), size);
+  const size_t target = plan->size() + count;
+
+  // Partially order the species to find the survivors in O(size)
+  thread_local std::vector<size_t> ranked;
+  ranked.resize(size);
+  std::iota(ranked.begin(), ranked.end(), begin);
+  Descending fitter(fitnesses);
+  std::nth_element(ranked.begin(), ranked.begin() + survivors - 1,
+                   ranked.end(), fitter);
+  std::sort(ranked.begin(), ranked.begin() + survivors, fitter);
+
+  plan->push_back({ranked[0], ranked[0], Operator::kCopy});
+  for (size_t i = 0; i + 1 < survivors; i++) {
+    for (size_t j = i + 1; j < survivors && plan->size() < target; j++) {
+      plan->push_back({ranked[i], ranked[j], Operator::kCrossover});
+    }
+  }
+  for (size_t i = 0; plan->size() < target; i++) {
+    clone(ranked[i % survivors], 1, plan);
+  }
+}
+
+TournamentSelector::TournamentSelector(size_t tournament_size)
+    : tournament_size_(tournament_size) {
+  ASSERT(tournament_size_ >= 1, "Tournament size: %zu\n", tournament_size_);
+}
+
+void TournamentSelector::plan(const std::vector<double>& fitnesses,
+                              size_t begin, size_t end, size_t count,
+                              std::vector<Mating>* plan) const {
+  if (count == 0) {
+    return;
+  } else if (end - begin == 1) {
+    clone(begin, count, plan);
+    return;
+  }
+
+  Descending fitter(fitnesses);
+  auto tournament = [&]() {
+    size_t best = utils::random::uniform_int(begin, end - 1);
+    for (size_t i = 1; i < tournament_size_; i++) {
+      size_t contender = utils::random::uniform_int(begin, end - 1);
+      if (fitter(contender, best)) {
+        best = contender;
+      }
+    }
+    return best;
+  };
+
+  size_t champion = fittest(fitnesses, begin, end);
+  plan->push_back({champion, champion, Operator::kCopy});
+  for (size_t i = 1; i < count; i++) {
+    size_t a = tournament();
+    size_t b = tournament();
+    mate(fitnesses, a, b, plan);
+  }
+}
+
+void StochasticUniversalSelector::plan(const std::vector<double>& fitnesses,
+                                       size_t begin, size_t end, size_t count,
+                                       std::vector<Mating>* plan) const {
+  if (count == 0) {
+    return;
+  } else if (end - begin == 1) {
+    clone(begin, count, plan);
+    return;
+  }
+
+  size_t champion = fittest(fitnesses, begin, end);
+  plan->push_back({champion, champion, Operator::kCopy});
+  const size_t matings = count - 1;
+  if (matings == 0) {
+    return;
+  }
+
+  double total = 0;
+  for (size_t i = begin; i < end; i++) {
+    total += std::max(fitnesses[i], 0.0);
+  }
+  // Without any positive fitness, sample uniformly
+  const bool uniform = !(total > 0) || !std::isfinite(total);
+  auto weight = [&](size_t i) {
+    return uniform ? 1.0 : std::max(fitnesses[i], 0.0);
+  };
+  if (uniform) {
+    total = end - begin;
+  }
+
+  // Two parents per mating, from a single spin with evenly spaced pointers
+  const size_t draws = 2 * matings;
+  const double step = total / draws;
+  const double start = utils::random::uniform(0, step);
+  thread_local std::vector<size_t> parents;
+  parents.clear();
+  double cumulative = 0;
+  size_t genome = begin;
+  for (size_t k = 0; k < draws; k++) {
+    double pointer = start + k * step;
+    while (genome + 1 < end && cumulative + weight(genome) <= pointer) {
+      cumulative += weight(genome);
+      genome++;
+    }
+    parents.push_back(genome);
+  }
+
+  // Parents are in population order, so pair each with one half a spin away
+  for (size_t i = 0; i < matings; i++) {
+    mate(fitnesses, parents[i], parents[i + matings], plan);
+  }
+}
+
+std::unique_ptr<Selector> create(const Config_Reproduction& config) {
+  switch (config.selection()) {
+    case Config_Reproduction::TOURNAMENT:
+      return std::make_unique<TournamentSelector>(
+          std::max(config.tournament_size(), 2u));
+    case Config_Reproduction::STOCHASTIC_UNIVERSAL:
+      return std::make_unique<StochasticUniversalSelector>();
+    default:
+      return std::make_unique<TruncationSelector>();
+  }
+}
+
+void allocate_offspring(const std::vector<double>& shares, size_t total,
+                        std::vector<size_t>* counts) {
+  const size_t size = shares.size();
+  counts->assign(size, 0);
+  if (size == 0) {
+    return;
+  }
+
+  auto share = [&shares](size_t i) {
+    return std::isfinite(shares[i]) ? std::max(shares[i], 0.0) : 0.0;
+  };
+  double sum = 0;
+  for (size_t i = 0; i < size; i++) {
+    sum += share(i);
+  }
+
+  // Give each species the integer part of its quota
+  std::vector<double> remainders(size);
+  size_t assigned = 0;
+  for (size_t i = 0; i < size; i++) {
+    double quota = sum > 0 ? share(i) / sum * total : (double)total / size;
+    double whole = std::floor(quota);
+    counts->at(i) = whole;
+    remainders[i] = quota - whole;
+    assigned += counts->at(i);
+  }
+  ASSERT(assigned <= total, "Assigned: %zu, Total: %zu\n", assigned, total);
+
+  // Then one more to each of the species with the largest remainders
+  const size_t remaining = std::min(total - assigned, size);
+  std::vector<size_t> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  Descending larger(remainders);
+  std::nth_element(order.begin(), order.begin() + remaining, order.end(),
+                   larger);
+  for (size_t i = 0; i < remaining; i++) {
+    counts->at(order[i])++;
+  }
+}
+
+}  // namespace selection
@@ -0,0 +1,238 @@
+#include "neat_lstm/sequence_trie.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "macros/assert.h"
+#include "neat_lstm/compiled_network.h"
+
+namespace {
+
+// FNV-1a hash of a node's parent and input bytes
+size_t hash_child(int parent, const void* input, size_t bytes) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+  };
+  mix(reinterpret_cast<const unsigned char*>(&parent), sizeof(parent));
+  mix(static_cast<const unsigned char*>(input), bytes);
+  return hash;
+}
+
+}  // namespace
+
+template <typename Scalar>
+SequenceTrie<Scalar>::SequenceTrie(size_t input_size)
+    : input_size_(input_size), nodes_{{-1, -1, -1, 0, 0}},
+      inputs_(input_size, 0) {}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::add(const Scalar* inputs, size_t length) {
+  const size_t row = total_length_;
+  int node = 0;
+  for (size_t t = 0; t < length; t++) {
+    node = child(node, inputs + t * input_size_, row + t);
+  }
+  sequence_ends_.push_back(node);
+  sequence_rows_.push_back(row);
+  total_length_ += length;
+  return sequence_ends_.size() - 1;
+}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::input_size() const {
+  return input_size_;
+}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::sequence_count() const {
+  return sequence_ends_.size();
+}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::total_length() const {
+  return total_length_;
+}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::node_count() const {
+  // Excluding the root
+  return nodes_.size() - 1;
+}
+
+template <typename Scalar>
+size_t SequenceTrie<Scalar>::evaluate(CompiledNetwork<Scalar>& network,
+                                      Scalar* outputs,
+                                      size_t memory_cap) const {
+  ASSERT(network.input_size() == (int)input_size_,
+         "Network inputs: %d, Sequence inputs: %zu\n", network.input_size(),
+         input_size_);
+  const size_t output_size = network.output_size();
+  const size_t snapshot_bytes = network.state_size() * sizeof(Scalar);
+  const size_t max_snapshots = snapshot_bytes == 0
+                                   ? std::numeric_limits<size_t>::max()
+                                   : memory_cap / snapshot_bytes;
+
+  // A node on the current path with children left to evaluate
+  struct Branch {
+    int node;
+    int next_child;
+    // Number of children left, including next_child
+    size_t remaining;
+    // Index of the saved state after the node, or -1 if there is none
+    int snapshot;
+  };
+  std::vector<Branch> branches;
+  // Nodes from the root (excluded) to the current node, by depth - 1
+  std::vector<int> path;
+  std::vector<std::vector<Scalar>> snapshots;
+  std::vector<int> free_snapshots;
+  size_t saved = 0;
+  size_t steps = 0;
+
+  auto step = [&](int node) {
+    network.activate(&inputs_[node * input_size_]);
+    steps++;
+  };
+
+  // Timesteps to replay to recompute the state after branch i from the
+  // closest saved state before it
+  auto replay_length = [&](size_t i) {
+    size_t j = i;
+    while (j > 0 && branches[j - 1].snapshot < 0) {
+      j--;
+    }
+    size_t from = j > 0 ? nodes_[branches[j - 1].node].depth : 0;
+    return nodes_[branches[i].node].depth - from;
+  };
+
+  // Saves the state after the node of the last branch, unless it is the
+  // cheapest state to recompute and the memory cap is reached.
+  auto save = [&]() {
+    const size_t last = branches.size() - 1;
+    if (saved == max_snapshots) {
+      size_t cheapest = last;
+      size_t cheapest_cost = branches[last].remaining * replay_length(last);
+      for (size_t i = 0; i < last; i++) {
+        size_t cost = branches[i].remaining * replay_length(i);
+        if (branches[i].snapshot >= 0 && cost < cheapest_cost) {
+          cheapest = i;
+          cheapest_cost = cost;
+        }
+      }
+      if (cheapest == last) {
+        return;
+      }
+      free_snapshots.push_back(branches[cheapest].snapshot);
+      branches[cheapest].snapshot = -1;
+      saved--;
+    }
+    if (free_snapshots.empty()) {
+      free_snapshots.push_back(snapshots.size());
+      snapshots.emplace_back(network.state_size());
+    }
+    branches[last].snapshot = free_snapshots.back();
+    free_snapshots.pop_back();
+    network.save_state(snapshots[branches[last].snapshot].data());
+    saved++;
+  };
+
+  // Brings the network to the state after the node of the last branch
+  auto restore = [&]() {
+    size_t j = branches.size();
+    while (j > 0 && branches[j - 1].snapshot < 0) {
+      j--;
+    }
+    size_t from = 0;
+    if (j > 0) {
+      network.restore_state(snapshots[branches[j - 1].snapshot].data());
+      from = nodes_[branches[j - 1].node].depth;
+    } else {
+      network.reset_state();
+    }
+    const size_t depth = nodes_[branches.back().node].depth;
+    for (size_t d = from; d < depth; d++) {
+      step(path[d]);
+    }
+    path.resize(depth);
+  };
+
+  network.reset_state();
+  int node = 0;
+  while (true) {
+    int next = nodes_[node].first_child;
+    if (next >= 0 && nodes_[next].next_sibling >= 0) {
+      size_t children = 0;
+      for (int c = next; c >= 0; c = nodes_[c].next_sibling) {
+        children++;
+      }
+      branches.push_back({node, nodes_[next].next_sibling, children - 1, -1});
+      save();
+    } else if (next < 0) {
+      // Continue with the next child of the deepest branch
+      if (branches.empty()) {
+        break;
+      }
+      restore();
+      Branch& branch = branches.back();
+      next = branch.next_child;
+      branch.next_child = nodes_[next].next_sibling;
+      if (--branch.remaining == 0) {
+        if (branch.snapshot >= 0) {
+          free_snapshots.push_back(branch.snapshot);
+          saved--;
+        }
+        branches.pop_back();
+      }
+    }
+    node = next;
+    path.push_back(node);
+    step(node);
+    network.activations(outputs + nodes_[node].output_row * output_size);
+  }
+
+  // Copy the outputs of shared nodes to the other sequences through them
+  for (size_t s = 0; s < sequence_ends_.size(); s++) {
+    size_t row = sequence_rows_[s] + nodes_[sequence_ends_[s]].depth;
+    for (int n = sequence_ends_[s]; n != 0; n = nodes_[n].parent) {
+      row--;
+      if (nodes_[n].output_row != row) {
+        std::copy_n(outputs + nodes_[n].output_row * output_size, output_size,
+                    outputs + row * output_size);
+      }
+    }
+  }
+  return steps;
+}
+
+template <typename Scalar>
+int SequenceTrie<Scalar>::child(int parent, const Scalar* input,
+                                size_t output_row) {
+  const size_t bytes = input_size_ * sizeof(Scalar);
+  const size_t hash = hash_child(parent, input, bytes);
+  auto range = children_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    int node = it->second;
+    if (nodes_[node].parent == parent &&
+        std::memcmp(&inputs_[node * input_size_], input, bytes) == 0) {
+      return node;
+    }
+  }
+
+  int node = nodes_.size();
+  nodes_.push_back({parent, -1, nodes_[parent].first_child,
+                    nodes_[parent].depth + 1, output_row});
+  nodes_[parent].first_child = node;
+  inputs_.insert(inputs_.end(), input, input + input_size_);
+  children_.insert({hash, node});
+  return node;
+}
+
+template class SequenceTrie<float>;
+template class SequenceTrie<double>;
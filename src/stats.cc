@@ -0,0 +1,154 @@
+#include "neat_lstm/stats.h"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stats {
+
+namespace {
+
+std::mutex& threads_mutex() {
+  static std::mutex* mutex = new std::mutex();
+  return *mutex;
+}
+
+// Intentionally leaked, as threads may record during static destruction.
+std::vector<internal::ThreadTotals*>& threads() {
+  static auto* threads = new std::vector<internal::ThreadTotals*>();
+  return *threads;
+}
+
+}  // namespace
+
+const char* name(Phase phase) {
+  switch (phase) {
+    case kEvaluation:
+      return "evaluation";
+    case kSpeciation:
+      return "speciation";
+    case kReproduction:
+      return "reproduction";
+    case kSelection:
+      return "selection";
+    case kMutation:
+      return "mutation";
+    default:
+      return "unknown";
+  }
+}
+
+const char* name(Counter counter) {
+  switch (counter) {
+    case kCompatibilityChecks:
+      return "compatibility_checks";
+    case kCrossovers:
+      return "crossovers";
+    case kStructuralMutations:
+      return "structural_mutations";
+    case kNetworksBuilt:
+      return "networks_built";
+    case kBytesAllocated:
+      return "bytes_allocated";
+    case kWorkerRestarts:
+      return "worker_restarts";
+    default:
+      return "unknown";
+  }
+}
+
+bool enabled() {
+#ifdef NEAT_LSTM_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string GenerationStats::csv_header() {
+  std::string header = "generation";
+  for (int p = 0; p < kPhaseCount; p++) {
+    header += std::string(",") + name((Phase)p) + "_seconds";
+  }
+  for (int c = 0; c < kCounterCount; c++) {
+    header += std::string(",") + name((Counter)c);
+  }
+  return header;
+}
+
+std::string GenerationStats::csv() const {
+  std::string line = std::to_string(generation);
+  char value[32];
+  for (int p = 0; p < kPhaseCount; p++) {
+    std::snprintf(value, sizeof(value), ",%.9f", phase_seconds[p]);
+    line += value;
+  }
+  for (int c = 0; c < kCounterCount; c++) {
+    line += "," + std::to_string(counters[c]);
+  }
+  return line;
+}
+
+std::string GenerationStats::json() const {
+  std::string object = "{\"generation\":" + std::to_string(generation);
+  char value[32];
+  for (int p = 0; p < kPhaseCount; p++) {
+    std::snprintf(value, sizeof(value), "%.9f", phase_seconds[p]);
+    object += std::string(",\"") + name((Phase)p) + "_seconds\":" + value;
+  }
+  for (int c = 0; c < kCounterCount; c++) {
+    object += std::string(",\"") + name((Counter)c) +
+              "\":" + std::to_string(counters[c]);
+  }
+  return object + "}";
+}
+
+Recorder::Recorder() { next(0); }
+
+GenerationStats Recorder::next(int generation) {
+  GenerationStats totals;
+  {
+    std::lock_guard<std::mutex> lock(threads_mutex());
+    for (const internal::ThreadTotals* thread : threads()) {
+      for (int p = 0; p < kPhaseCount; p++) {
+        totals.phase_seconds[p] +=
+            thread->phase_ns[p].load(std::memory_order_relaxed) * 1e-9;
+      }
+      for (int c = 0; c < kCounterCount; c++) {
+        totals.counters[c] +=
+            thread->counters[c].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  GenerationStats stats;
+  stats.generation = generation;
+  for (int p = 0; p < kPhaseCount; p++) {
+    stats.phase_seconds[p] = totals.phase_seconds[p] - totals_.phase_seconds[p];
+  }
+  for (int c = 0; c < kCounterCount; c++) {
+    stats.counters[c] = totals.counters[c] - totals_.counters[c];
+  }
+  totals_ = totals;
+  return stats;
+}
+
+namespace internal {
+
+ThreadTotals* register_thread() {
+  auto* totals = new ThreadTotals();
+  for (auto& phase_ns : totals->phase_ns) {
+    phase_ns.store(0, std::memory_order_relaxed);
+  }
+  for (auto& counter : totals->counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  std::lock_guard<std::mutex> lock(threads_mutex());
+  threads().push_back(totals);
+  return totals;
+}
+
+}  // namespace internal
+
+}  // namespace stats
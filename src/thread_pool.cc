@@ -0,0 +1,143 @@
+#include "neat_lstm/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+ThreadPool::ThreadPool(size_t size) {
+  if (size == 0) {
+    size = std::max(1u, std::thread::hardware_concurrency());
+  }
+  stats_.resize(size);
+  for (size_t i = 0; i < size; i++) {
+    queues_.emplace_back(new Queue());
+  }
+  for (size_t i = 0; i < size; i++) {
+    workers_.emplace_back(&ThreadPool::work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::size() const { return workers_.size(); }
+
+void ThreadPool::run(const std::vector<size_t>& order, const Task& task) {
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t q = 0; q < queues_.size(); q++) {
+    Queue& queue = *queues_.at(q);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.clear();
+    for (size_t i = q; i < order.size(); i += queues_.size()) {
+      queue.tasks.push_back(order.at(i));
+    }
+    queue.front = 0;
+    queue.back = queue.tasks.size();
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    active_workers_ = workers_.size();
+    batch_++;
+    start_.notify_all();
+    done_.wait(lock, [this] { return active_workers_ == 0; });
+    task_ = nullptr;
+  }
+
+  run_seconds_ += std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+void ThreadPool::parallel_for(size_t count, const Task& task) {
+  std::vector<size_t> order(count);
+  std::iota(order.begin(), order.end(), 0);
+  run(order, task);
+}
+
+const std::vector<ThreadPool::WorkerStats>& ThreadPool::stats() const {
+  return stats_;
+}
+
+double ThreadPool::utilisation(size_t worker) const {
+  return run_seconds_ > 0 ? stats_.at(worker).busy_seconds / run_seconds_ : 0;
+}
+
+void ThreadPool::reset_stats() {
+  stats_.assign(stats_.size(), WorkerStats());
+  run_seconds_ = 0;
+}
+
+void ThreadPool::work(size_t worker) {
+  size_t batch = 0;
+  while (true) {
+    const Task* task = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, batch] { return stopping_ || batch_ != batch; });
+      if (stopping_) {
+        return;
+      }
+      batch = batch_;
+      task = task_;
+    }
+
+    // Only this worker writes its stats while a batch runs
+    WorkerStats& stats = stats_.at(worker);
+    size_t index;
+    bool stolen;
+    while (next_task(worker, index, stolen)) {
+      auto start = std::chrono::steady_clock::now();
+      (*task)(index, worker);
+      stats.busy_seconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+      stats.tasks++;
+      stats.steals += stolen;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_workers_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+}
+
+bool ThreadPool::next_task(size_t worker, size_t& task, bool& stolen) {
+  {
+    Queue& own = *queues_.at(worker);
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.front < own.back) {
+      task = own.tasks.at(own.front++);
+      stolen = false;
+      return true;
+    }
+  }
+
+  // Tasks are never added during a batch, so one pass over the other queues
+  // finding nothing means the batch is fully claimed
+  for (size_t i = 1; i < queues_.size(); i++) {
+    Queue& victim = *queues_.at((worker + i) % queues_.size());
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.front < victim.back) {
+      task = victim.tasks.at(--victim.back);
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
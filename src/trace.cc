@@ -0,0 +1,187 @@
+#include "neat_lstm/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+namespace internal {
+
+std::atomic<bool> recording{false};
+
+}  // namespace internal
+
+namespace {
+
+// Fields are atomic so that write() can read a buffer while its thread
+// overwrites old spans; torn spans are detected and dropped.
+struct Span {
+  std::atomic<const char*> name;
+  std::atomic<int64_t> arg;
+  std::atomic<uint64_t> begin_ns;
+  std::atomic<uint64_t> end_ns;
+};
+
+// Ring buffer of a thread, written only by that thread. The thread resets it
+// for the current start() when it next records, with the state mutex held, so
+// that no other thread ever writes the buffer and write() can read it under
+// the mutex.
+struct Buffer {
+  size_t id;
+  // Value of epoch when the buffer was last reset
+  uint64_t epoch;
+  size_t capacity;
+  std::unique_ptr<Span[]> spans;
+  // Number of spans recorded since the reset; the newest capacity of them are
+  // kept
+  std::atomic<uint64_t> head{0};
+};
+
+struct State {
+  std::mutex mutex;
+  // Buffers of all threads that ever recorded. They outlive their threads.
+  std::vector<Buffer*> buffers;
+  size_t capacity = 1 << 16;
+  uint64_t start_ns = 0;
+};
+
+// Number of calls to start(), incremented with the state mutex held
+std::atomic<uint64_t> epoch{0};
+
+// Intentionally leaked, as threads may record during static destruction.
+State& state() {
+  static State* state = new State();
+  return *state;
+}
+
+// Empties the buffer for the current start(), reallocating its spans only if
+// the capacity changed. Requires the state mutex.
+void reset(const State& state, Buffer* buffer) {
+  if (buffer->spans == nullptr || buffer->capacity != state.capacity) {
+    buffer->capacity = state.capacity;
+    buffer->spans.reset(new Span[state.capacity]);
+  }
+  buffer->head.store(0, std::memory_order_relaxed);
+  buffer->epoch = epoch.load(std::memory_order_relaxed);
+}
+
+Buffer* register_thread() {
+  State& state = trace::state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  Buffer* buffer = new Buffer();
+  buffer->id = state.buffers.size();
+  reset(state, buffer);
+  state.buffers.push_back(buffer);
+  return buffer;
+}
+
+Buffer& local() {
+  thread_local Buffer* buffer = register_thread();
+  return *buffer;
+}
+
+}  // namespace
+
+void start(size_t capacity) {
+  State& state = trace::state();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.capacity = std::max(capacity, (size_t)1);
+    state.start_ns = internal::now_ns();
+    epoch.fetch_add(1, std::memory_order_relaxed);
+  }
+  internal::recording.store(true, std::memory_order_release);
+}
+
+void stop() { internal::recording.store(false, std::memory_order_release); }
+
+bool write(const std::string& path) {
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  State& state = trace::state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  std::fprintf(file,
+               "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+               "\"args\":{\"name\":\"neat_lstm\"}}");
+  for (const Buffer* buffer : state.buffers) {
+    std::fprintf(file,
+                 ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                 "\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+                 buffer->id, buffer->id);
+    // Spans of threads that have not recorded since start() are older
+    if (buffer->epoch != epoch.load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    const uint64_t capacity = buffer->capacity;
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t begin = head > capacity ? head - capacity : 0;
+    for (uint64_t i = begin; i < head; i++) {
+      const Span& span = buffer->spans[i % capacity];
+      const char* name = span.name.load(std::memory_order_relaxed);
+      int64_t arg = span.arg.load(std::memory_order_relaxed);
+      uint64_t begin_ns = span.begin_ns.load(std::memory_order_relaxed);
+      uint64_t end_ns = span.end_ns.load(std::memory_order_relaxed);
+      // Drop the span if its slot may have been reused while reading it
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (buffer->head.load(std::memory_order_relaxed) >= i + capacity ||
+          begin_ns < state.start_ns) {
+        continue;
+      }
+
+      std::fprintf(file,
+                   ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+                   "\"ts\":%.3f,\"dur\":%.3f",
+                   name, buffer->id, (begin_ns - state.start_ns) * 1e-3,
+                   (end_ns - begin_ns) * 1e-3);
+      if (arg != kNoArg) {
+        std::fprintf(file, ",\"args\":{\"arg\":%lld}", (long long)arg);
+      }
+      std::fprintf(file, "}");
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+namespace internal {
+
+void record(const char* name, int64_t arg, uint64_t begin_ns,
+            uint64_t end_ns) {
+  Buffer& buffer = local();
+  if (buffer.epoch != epoch.load(std::memory_order_relaxed)) {
+    State& state = trace::state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    reset(state, &buffer);
+  }
+  uint64_t head = buffer.head.load(std::memory_order_relaxed);
+  // Orders the publication of head, which tells readers that this slot is
+  // about to be reused, before the overwrite
+  std::atomic_thread_fence(std::memory_order_release);
+  Span& span = buffer.spans[head % buffer.capacity];
+  span.name.store(name, std::memory_order_relaxed);
+  span.arg.store(arg, std::memory_order_relaxed);
+  span.begin_ns.store(begin_ns, std::memory_order_relaxed);
+  span.end_ns.store(end_ns, std::memory_order_relaxed);
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace internal
+
+}  // namespace trace
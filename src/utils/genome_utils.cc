@@ -3,7 +3,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <limits>
+#include <vector>
 
+#include "macros/stats.h"
 #include "neat_lstm/config_store.h"
 #include "neat_lstm/innovation.h"
 #include "neat_lstm/utils/node_utils.h"
@@ -11,9 +14,106 @@
 #include "proto/structures.pb.h"
 
 namespace utils {
+namespace {
+
+const double kUnbounded = std::numeric_limits<double>::infinity();
+
+// Uniform access to the connections of a genome and of FlatConnections
+struct GenomeConnections {
+  const Genome& genome;
+};
+
+int size(const GenomeConnections& c) { return c.genome.connections_size(); }
+int innovation(const GenomeConnections& c, int i) {
+  return c.genome.connections(i).innovation();
+}
+double weight(const GenomeConnections& c, int i) {
+  return c.genome.connections(i).weight();
+}
+
+int size(const FlatConnections& c) { return c.innovations.size(); }
+int innovation(const FlatConnections& c, int i) { return c.innovations[i]; }
+double weight(const FlatConnections& c, int i) { return c.weights[i]; }
+
+// Measures compatibility, returning infinity as soon as the excess and
+// disjoint terms alone are known to reach the threshold. With non-negative
+// coefficients, both terms only grow during the merge and the weight term is
+// non-negative, so exiting early does not change whether the result is below
+// the threshold. Any negative coefficient disables the early exit.
+template <typename Connections>
+double bounded_compatibility(const Connections& a, const Connections& b,
+                             double threshold) {
+  STATS_COUNT(stats::kCompatibilityChecks, 1);
+  const auto& config = ConfigStore::speciation();
+  const int a_size = size(a);
+  const int b_size = size(b);
+
+  int N;
+  if (a_size < 20 && b_size < 20) {
+    N = 1;
+  } else {
+    N = std::max(a_size, b_size);
+  }
+
+  // Smallest disjoint count at which the disjoint term alone reaches the
+  // threshold
+  int disjoint_limit = std::numeric_limits<int>::max();
+  const double c = config.disjoint_coefficient();
+  if (threshold != kUnbounded && c > 0 && config.excess_coefficient() >= 0 &&
+      config.weights_coefficient() >= 0 &&
+      threshold * N / c < a_size + b_size) {
+    disjoint_limit = std::max(0, (int)std::ceil(threshold * N / c));
+    // Correct rounding so the limit agrees with the final expression
+    while (disjoint_limit > 0 && c * (disjoint_limit - 1) / N >= threshold) {
+      disjoint_limit--;
+    }
+    while (c * disjoint_limit / N < threshold) {
+      disjoint_limit++;
+    }
+  }
+
+  int disjoint_count = 0;
+  int matching_count = 0;
+  double weight_diff_sum = 0;
+
+  // Branch-free merge of the innovation-sorted genes
+  int i = 0;
+  int j = 0;
+  while (i < a_size && j < b_size) {
+    int a_innovation = innovation(a, i);
+    int b_innovation = innovation(b, j);
+    bool matching = a_innovation == b_innovation;
+    weight_diff_sum += matching ? std::abs(weight(a, i) - weight(b, j)) : 0;
+    matching_count += matching;
+    disjoint_count += !matching;
+    i += a_innovation <= b_innovation;
+    j += b_innovation <= a_innovation;
+
+    if (disjoint_count >= disjoint_limit) {
+      return kUnbounded;
+    }
+  }
+  // Genes remaining after either genome runs out are excess
+  int excess_count = (a_size - i) + (b_size - j);
+
+  return config.excess_coefficient() * excess_count / N +
+         config.disjoint_coefficient() * disjoint_count / N +
+         config.weights_coefficient() * weight_diff_sum / matching_count;
+}
+
+}  // namespace
 
 int genome_id = 0;
 
+FlatConnections::FlatConnections(const Genome& genome) {
+  innovations.reserve(genome.connections_size());
+  weights.reserve(genome.connections_size());
+  for (const auto& connection : genome.connections()) {
+    innovations.push_back(connection.innovation());
+    weights.push_back(connection.weight());
+  }
+}
+
 Genome create_genome(size_t input_size, size_t output_size) {
   Genome genome;
   genome.set_id(genome_id++);
@@ -80,51 +180,36 @@ bool check_connections(const Genome& genome) {
 }
 
 double compatibility(const Genome& a, const Genome& b) {
-  // TODO: Include differences in LSTM units for compatibility measure
-  int excess_count = 0;
-  int disjoint_count = 0;
-  int matching_count = 0;
-  double weight_diff_sum = 0;
+  return bounded_compatibility(GenomeConnections{a}, GenomeConnections{b},
+                               kUnbounded);
+}
 
-  auto a_it = a.connections().begin();
-  auto b_it = b.connections().begin();
-
-  while (a_it != a.connections().end() || b_it != b.connections().end()) {
-    if (a_it == a.connections().end()) {
-      excess_count++;
-      b_it++;
-      continue;
-    } else if (b_it == b.connections().end()) {
-      excess_count++;
-      a_it++;
-      continue;
-    }
-    if (a_it->innovation() == b_it->innovation()) {
-      matching_count++;
-      weight_diff_sum += std::abs(a_it->weight() - b_it->weight());
-      a_it++;
-      b_it++;
-    } else if (a_it->innovation() < b_it->innovation()) {
-      disjoint_count++;
-      a_it++;
-    } else {
-      disjoint_count++;
-      b_it++;
-    }
-  }
+double compatibility(const FlatConnections& a, const FlatConnections& b) {
+  return bounded_compatibility(a, b, kUnbounded);
+}
 
-  int N;
-  if (a.connections_size() < 20 && b.connections_size() < 20) {
-    N = 1;
-  } else {
-    N = std::max(a.connections_size(), b.connections_size());
-  }
+bool compatible(const Genome& a, const Genome& b, double threshold) {
+  return bounded_compatibility(GenomeConnections{a}, GenomeConnections{b},
+                               threshold) < threshold;
+}
 
-  auto config = ConfigStore::speciation();
+bool compatible(const FlatConnections& a, const FlatConnections& b,
+                double threshold) {
+  return bounded_compatibility(a, b, threshold) < threshold;
+}
 
-  return config.excess_coefficient() * excess_count / N +
-         config.disjoint_coefficient() * disjoint_count / N +
-         config.weights_coefficient() * weight_diff_sum / matching_count;
+int first_compatible(const FlatConnections& genome,
+                     const std::vector<const FlatConnections*>& representatives,
+                     size_t begin, size_t end, double threshold) {
+  // Compatibility is symmetric, but keep the representative first as in
+  // Species::compatible()
+  for (size_t i = begin; i < end; i++) {
+    if (bounded_compatibility(*representatives[i], genome, threshold) <
+        threshold) {
+      return i;
+    }
+  }
+  return -1;
 }
 
 Node_Type node_type(const Genome& genome, int id) {
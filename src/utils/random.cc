@@ -1,32 +1,200 @@
 #include "neat_lstm/utils/random.h"
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <random>
 
 namespace utils {
+namespace random {
 namespace {
 
-std::default_random_engine& generator() {
-  static std::random_device rd;
-  static std::default_random_engine generator{rd()};
+// Philox4x32 constants
+const uint32_t kMultiplier0 = 0xD2511F53;
+const uint32_t kMultiplier1 = 0xCD9E8D57;
+const uint32_t kWeyl0 = 0x9E3779B9;
+const uint32_t kWeyl1 = 0xBB67AE85;
+const int kRounds = 10;
+
+// Generation of the default streams of threads outside of any ScopedStream
+const uint64_t kDefaultGeneration = 0xFFFFFFFF;
+
+// SplitMix64 finalizer, used to spread seeds over the key space
+uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
 
-  return generator;
+uint64_t random_seed() {
+  std::random_device rd;
+  return (uint64_t)rd() << 32 | rd();
 }
 
+std::atomic<uint64_t>& run_seed() {
+  static std::atomic<uint64_t> seed{random_seed()};
+  return seed;
+}
+
+// Incremented by seed() so default streams know to restart
+std::atomic<uint64_t>& seed_epoch() {
+  static std::atomic<uint64_t> epoch{0};
+  return epoch;
+}
+
+thread_local ScopedStream* current_scope = nullptr;
+
+// Returns the stream used by the free functions on this thread.
+Stream& current_stream();
+
 }  // namespace
 
-namespace random {
+Stream::Stream(uint64_t seed, uint64_t generation, uint64_t id) {
+  uint64_t key = mix(seed);
+  key_[0] = (uint32_t)key;
+  key_[1] = (uint32_t)(key >> 32);
+  // The low 64 bits of the counter index draws within the stream
+  counter_[0] = 0;
+  counter_[1] = 0;
+  counter_[2] = (uint32_t)id;
+  counter_[3] = (uint32_t)generation;
+}
 
-double uniform(double start, double end) {
+uint64_t Stream::next() {
+  if (buffered_ == 0) {
+    refill();
+  }
+  return buffer_[--buffered_];
+}
+
+void Stream::next(uint64_t* values, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    values[i] = next();
+  }
+}
+
+double Stream::uniform(double start, double end) {
   assert(start <= end);
-  std::uniform_real_distribution<double> distribution{start, end};
-  return distribution(generator());
+  // 53 random bits mapped to [0, 1)
+  double unit = (next() >> 11) * (1.0 / 9007199254740992.0);
+  return start + (end - start) * unit;
 }
 
-int uniform_int(int start, int end) {
+int Stream::uniform_int(int start, int end) {
   assert(start <= end);
-  std::uniform_int_distribution<int> distribution{start, end};
-  return distribution(generator());
+  uint64_t range = (uint64_t)((int64_t)end - start) + 1;
+  // Lemire's multiply-shift with rejection of the biased low range
+  __uint128_t product = (__uint128_t)next() * range;
+  uint64_t low = (uint64_t)product;
+  if (low < range) {
+    uint64_t threshold = -range % range;
+    while (low < threshold) {
+      product = (__uint128_t)next() * range;
+      low = (uint64_t)product;
+    }
+  }
+  return (int)(start + (int64_t)(product >> 64));
+}
+
+void Stream::uniform(double* values, size_t size, double start, double end) {
+  assert(start <= end);
+  const double scale = (end - start) * (1.0 / 9007199254740992.0);
+  for (size_t i = 0; i < size; i++) {
+    values[i] = start + (next() >> 11) * scale;
+  }
+}
+
+void Stream::refill() {
+  uint32_t c[4] = {counter_[0], counter_[1], counter_[2], counter_[3]};
+  uint32_t k[2] = {key_[0], key_[1]};
+  for (int round = 0; round < kRounds; round++) {
+    uint64_t product_0 = (uint64_t)kMultiplier0 * c[0];
+    uint64_t product_1 = (uint64_t)kMultiplier1 * c[2];
+    uint32_t next[4] = {(uint32_t)(product_1 >> 32) ^ c[1] ^ k[0],
+                        (uint32_t)product_1,
+                        (uint32_t)(product_0 >> 32) ^ c[3] ^ k[1],
+                        (uint32_t)product_0};
+    c[0] = next[0];
+    c[1] = next[1];
+    c[2] = next[2];
+    c[3] = next[3];
+    k[0] += kWeyl0;
+    k[1] += kWeyl1;
+  }
+  buffer_[0] = (uint64_t)c[0] << 32 | c[1];
+  buffer_[1] = (uint64_t)c[2] << 32 | c[3];
+  buffered_ = 2;
+
+  // Increment the 64-bit draw index
+  if (++counter_[0] == 0) {
+    counter_[1]++;
+  }
+}
+
+void seed(uint64_t seed) {
+  run_seed() = seed;
+  seed_epoch()++;
+}
+
+uint64_t seed() { return run_seed(); }
+
+Stream stream(uint64_t generation, uint64_t id) {
+  return Stream(run_seed(), generation, id);
+}
+
+ScopedStream::ScopedStream(uint64_t generation, uint64_t id)
+    : generation_(generation),
+      stream_(random::stream(generation, id)),
+      previous_(current_scope) {
+  current_scope = this;
+}
+
+ScopedStream::ScopedStream(uint64_t id)
+    : ScopedStream(current_scope ? current_scope->generation() : 0, id) {}
+
+ScopedStream::~ScopedStream() { current_scope = previous_; }
+
+uint64_t ScopedStream::generation() const { return generation_; }
+
+Stream& ScopedStream::stream() { return stream_; }
+
+namespace {
+
+Stream& current_stream() {
+  if (current_scope) {
+    return current_scope->stream();
+  }
+
+  // Each thread gets its own default stream, restarted when reseeded
+  static std::atomic<uint64_t> thread_count{0};
+  thread_local uint64_t thread_id = thread_count++;
+  thread_local uint64_t epoch = seed_epoch();
+  thread_local Stream default_stream{run_seed(), kDefaultGeneration,
+                                     thread_id};
+  if (epoch != seed_epoch()) {
+    epoch = seed_epoch();
+    default_stream = Stream(run_seed(), kDefaultGeneration, thread_id);
+  }
+  return default_stream;
+}
+
+}  // namespace
+
+double uniform(double start, double end) {
+  return current_stream().uniform(start, end);
+}
+
+int uniform_int(int start, int end) {
+  return current_stream().uniform_int(start, end);
+}
+
+void uniform(double* values, size_t size, double start, double end) {
+  current_stream().uniform(values, size, start, end);
+}
+
+void next(uint64_t* values, size_t size) {
+  current_stream().next(values, size);
 }
 
 }  // namespace random
@@ -0,0 +1,99 @@
+#include "neat_lstm/utils/record_io.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+namespace utils {
+
+namespace {
+
+// Reads a varint at position, advancing position past it. Returns false if the
+// varint is truncated or longer than 64 bits.
+bool read_varint(const uint8_t* data, size_t size, size_t* position,
+                 uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *position < size; shift += 7) {
+    uint8_t byte = data[(*position)++];
+    *value |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& path, std::string* error) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "Cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    *error = "Cannot read " + path;
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    *error = "Cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  data_ = (const uint8_t*)data;
+  size_ = status.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    munmap((void*)data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+const uint8_t* MappedFile::data() const { return data_; }
+
+size_t MappedFile::size() const { return size_; }
+
+MappedFile::MappedFile(MappedFile&& other)
+    : data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this != &other) {
+    close();
+    data_ = other.data_;
+    size_ = other.size_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+bool find_record(const uint8_t* data, size_t size, size_t position,
+                 size_t* start, size_t* length) {
+  uint64_t record_length;
+  if (!read_varint(data, size, &position, &record_length) ||
+      record_length > size - position) {
+    return false;
+  }
+  *start = position;
+  *length = record_length;
+  return true;
+}
+
+}  // namespace utils
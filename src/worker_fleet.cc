@@ -0,0 +1,390 @@
+#include "neat_lstm/worker_fleet.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "macros/stats.h"
+#include "macros/trace.h"
+#include "neat_lstm/evaluation.h"
+#include "neat_lstm/population.h"
+#include "neat_lstm/utils/record_io.h"
+#include "proto/structures.pb.h"
+#include "proto/worker.pb.h"
+
+namespace {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Bytes read from a socket at a time
+const size_t kReadSize = 1 << 16;
+
+// Sends all of data, blocking. Returns false if the peer is gone.
+bool send_all(int socket, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(socket, data.data() + sent, data.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// Main loop of a worker process: evaluates the batches received on the socket
+// until the coordinator closes it.
+void work(int socket, Evaluator& evaluator) {
+  std::string input;
+  std::string output;
+  char buffer[kReadSize];
+  WorkerBatch batch;
+  WorkerResult result;
+  while (true) {
+    size_t position = 0;
+    size_t start;
+    size_t length;
+    while (utils::find_record((const uint8_t*)input.data(), input.size(),
+                              position, &start, &length)) {
+      if (!batch.ParseFromArray(input.data() + start, length) ||
+          batch.tasks_size() != batch.genomes_size()) {
+        return;
+      }
+      position = start + length;
+      for (int i = 0; i < batch.genomes_size(); i++) {
+        result.set_task(batch.tasks(i));
+        result.set_fitness(evaluator.evaluate(batch.genomes(i)));
+        output.clear();
+        {
+          google::protobuf::io::StringOutputStream stream(&output);
+          CodedOutputStream coded(&stream);
+          coded.WriteVarint64(result.ByteSizeLong());
+          result.SerializeWithCachedSizes(&coded);
+        }
+        if (!send_all(socket, output)) {
+          return;
+        }
+      }
+    }
+    input.erase(0, position);
+
+    ssize_t n = recv(socket, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    input.append(buffer, n);
+  }
+}
+
+}  // namespace
+
+WorkerFleet::WorkerFleet(Evaluator& evaluator, const Options& options)
+    : evaluator_(evaluator), options_(options) {
+  if (options_.workers == 0) {
+    options_.workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+  options_.pipeline_depth = std::max<size_t>(options_.pipeline_depth, 1);
+}
+
+WorkerFleet::~WorkerFleet() {
+  for (Worker& worker : workers_) {
+    stop(worker);
+  }
+}
+
+bool WorkerFleet::start() {
+  workers_.resize(options_.workers);
+  for (Worker& worker : workers_) {
+    if (worker.pid < 0 && !spawn(worker)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WorkerFleet::evaluate(const std::vector<Genome*>& genomes,
+                           std::vector<double>* fitnesses) {
+  STATS_TIMER(stats::kEvaluation);
+  TRACE_SPAN("evaluate_workers");
+  genomes_ = &genomes;
+  fitnesses_ = fitnesses;
+  fitnesses->assign(genomes.size(), options_.failure_fitness);
+  attempts_.assign(genomes.size(), 0);
+  remaining_ = genomes.size();
+
+  // Most expensive first, as in evaluate() on threads
+  std::vector<double> costs(genomes.size());
+  for (size_t i = 0; i < genomes.size(); i++) {
+    costs.at(i) = evaluator_.cost(*genomes.at(i));
+  }
+  std::vector<size_t> order(genomes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+    return costs.at(a) > costs.at(b);
+  });
+  pending_.assign(order.begin(), order.end());
+
+  std::vector<pollfd> polls(workers_.size());
+  while (remaining_ > 0) {
+    for (size_t w = 0; w < workers_.size(); w++) {
+      Worker& worker = workers_.at(w);
+      if (options_.genomes_per_worker > 0 && worker.batches.empty() &&
+          worker.genomes_sent >= options_.genomes_per_worker) {
+        stop(worker);
+        if (!spawn(worker)) {
+          return false;
+        }
+      }
+      dispatch(worker);
+      if (!flush(worker)) {
+        if (!restart(worker)) {
+          return false;
+        }
+        // A failure of the replacement shows up in poll()
+        dispatch(worker);
+        flush(worker);
+      }
+      polls.at(w).fd = worker.socket;
+      polls.at(w).events =
+          worker.output.empty() ? POLLIN : (short)(POLLIN | POLLOUT);
+      polls.at(w).revents = 0;
+    }
+    if (remaining_ == 0) {
+      break;
+    }
+
+    if (poll(polls.data(), polls.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error_ = std::string("Cannot poll workers: ") + std::strerror(errno);
+      return false;
+    }
+    for (size_t w = 0; w < workers_.size(); w++) {
+      Worker& worker = workers_.at(w);
+      short events = polls.at(w).revents;
+      bool alive = true;
+      if (events & (POLLIN | POLLHUP | POLLERR)) {
+        alive = receive(worker);
+      } else if (events & POLLOUT) {
+        alive = flush(worker);
+      }
+      if (!alive && !restart(worker)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool WorkerFleet::evaluate(Population& population) {
+  return evaluate(population.genomes_, &population.fitnesses_);
+}
+
+size_t WorkerFleet::size() const { return workers_.size(); }
+
+size_t WorkerFleet::restarts() const { return restarts_; }
+
+const std::string& WorkerFleet::error() const { return error_; }
+
+bool WorkerFleet::spawn(Worker& worker) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    error_ = std::string("Cannot create socket: ") + std::strerror(errno);
+    return false;
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    error_ = std::string("Cannot fork worker: ") + std::strerror(errno);
+    close(sockets[0]);
+    close(sockets[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // Only the worker's own end stays open, so that every worker sees its
+    // socket closed once the coordinator closes or exits
+    close(sockets[0]);
+    for (const Worker& other : workers_) {
+      if (other.socket >= 0) {
+        close(other.socket);
+      }
+    }
+    work(sockets[1], evaluator_);
+    // Skips the coordinator's exit handlers and buffered output
+    _exit(0);
+  }
+  close(sockets[1]);
+  worker.pid = pid;
+  worker.socket = sockets[0];
+  return true;
+}
+
+void WorkerFleet::stop(Worker& worker) {
+  if (worker.socket >= 0) {
+    close(worker.socket);
+  }
+  if (worker.pid > 0) {
+    while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) {
+    }
+  }
+  worker.pid = -1;
+  worker.socket = -1;
+  worker.output.clear();
+  worker.output_position = 0;
+  worker.input.clear();
+  worker.genomes_sent = 0;
+}
+
+bool WorkerFleet::restart(Worker& worker) {
+  restarts_++;
+  STATS_COUNT(stats::kWorkerRestarts, 1);
+  // The worker may be alive but unresponsive
+  if (worker.pid > 0) {
+    kill(worker.pid, SIGKILL);
+  }
+  stop(worker);
+
+  std::vector<size_t> unfinished;
+  for (const Batch& batch : worker.batches) {
+    unfinished.insert(unfinished.end(), batch.tasks.begin() + batch.done,
+                      batch.tasks.end());
+  }
+  worker.batches.clear();
+  // The first unfinished genome is the one the worker was evaluating
+  if (!unfinished.empty() &&
+      ++attempts_.at(unfinished.front()) >= options_.max_attempts) {
+    fitnesses_->at(unfinished.front()) = options_.failure_fitness;
+    remaining_--;
+    unfinished.erase(unfinished.begin());
+  }
+  pending_.insert(pending_.begin(), unfinished.begin(), unfinished.end());
+  return spawn(worker);
+}
+
+void WorkerFleet::dispatch(Worker& worker) {
+  // Genomes are written as fields of the batch, rather than copied into it
+  const uint32_t genome_tag =
+      WireFormatLite::MakeTag(WorkerBatch::kGenomesFieldNumber,
+                              WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  while (worker.batches.size() < options_.pipeline_depth &&
+         !pending_.empty()) {
+    if (options_.genomes_per_worker > 0 &&
+        worker.genomes_sent >= options_.genomes_per_worker) {
+      return;
+    }
+    Batch batch;
+    WorkerBatch message;
+    while (batch.tasks.size() < options_.batch_size && !pending_.empty()) {
+      batch.tasks.push_back(pending_.front());
+      message.add_tasks(pending_.front());
+      pending_.pop_front();
+    }
+
+    size_t size = message.ByteSizeLong();
+    for (size_t task : batch.tasks) {
+      size_t genome_size = genomes_->at(task)->ByteSizeLong();
+      size += CodedOutputStream::VarintSize32(genome_tag) +
+              CodedOutputStream::VarintSize64(genome_size) + genome_size;
+    }
+    {
+      google::protobuf::io::StringOutputStream stream(&worker.output);
+      CodedOutputStream coded(&stream);
+      coded.WriteVarint64(size);
+      message.SerializeWithCachedSizes(&coded);
+      for (size_t task : batch.tasks) {
+        const Genome& genome = *genomes_->at(task);
+        coded.WriteVarint32(genome_tag);
+        coded.WriteVarint64(genome.GetCachedSize());
+        genome.SerializeWithCachedSizes(&coded);
+      }
+    }
+    worker.genomes_sent += batch.tasks.size();
+    worker.batches.push_back(std::move(batch));
+  }
+}
+
+bool WorkerFleet::flush(Worker& worker) {
+  while (worker.output_position < worker.output.size()) {
+    const char* data = worker.output.data() + worker.output_position;
+    ssize_t n = send(worker.socket, data,
+                     worker.output.size() - worker.output_position,
+                     MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    worker.output_position += n;
+  }
+  worker.output.clear();
+  worker.output_position = 0;
+  return true;
+}
+
+bool WorkerFleet::receive(Worker& worker) {
+  // Results sent before the worker died are still applied
+  bool alive = true;
+  char buffer[kReadSize];
+  while (true) {
+    ssize_t n = recv(worker.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      alive = errno == EAGAIN || errno == EWOULDBLOCK;
+      break;
+    }
+    if (n == 0) {
+      alive = false;
+      break;
+    }
+    worker.input.append(buffer, n);
+  }
+
+  size_t position = 0;
+  size_t start;
+  size_t length;
+  WorkerResult result;
+  while (utils::find_record((const uint8_t*)worker.input.data(),
+                            worker.input.size(), position, &start, &length)) {
+    position = start + length;
+    // Results come in the order of the batches
+    if (!result.ParseFromArray(worker.input.data() + start, length) ||
+        worker.batches.empty() ||
+        worker.batches.front().tasks.at(worker.batches.front().done) !=
+            result.task()) {
+      return false;
+    }
+    fitnesses_->at(result.task()) = result.fitness();
+    remaining_--;
+    Batch& batch = worker.batches.front();
+    if (++batch.done == batch.tasks.size()) {
+      worker.batches.pop_front();
+    }
+  }
+  worker.input.erase(0, position);
+  return alive;
+}
@@ -0,0 +1,95 @@
+#include <cstdint>
+
+#include "neat_lstm/reproduction.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+#include "test.h"
+
+namespace {
+
+const int kStreams = 16;
+
+// The original crossover, which grows the child one connection at a time and
+// draws the choice of each matching gene as it is reached.
+void reference_crossover(const Genome& more_fit, const Genome& less_fit,
+                         Genome* child) {
+  Genome& genome = *child;
+  genome.set_input_size(more_fit.input_size());
+  genome.set_output_size(more_fit.output_size());
+  genome.set_max_node_id(more_fit.max_node_id());
+  genome.mutable_nodes()->CopyFrom(more_fit.nodes());
+
+  auto mf_it = more_fit.connections().begin();
+  auto lf_it = less_fit.connections().begin();
+  while (mf_it != more_fit.connections().end()) {
+    if (lf_it == less_fit.connections().end() ||
+        mf_it->innovation() < lf_it->innovation()) {
+      genome.add_connections()->CopyFrom(*mf_it);
+      mf_it++;
+    } else if (mf_it->innovation() == lf_it->innovation()) {
+      auto* connection = genome.add_connections();
+      if (utils::random::uniform_int(0, 1) == 0) {
+        connection->CopyFrom(*mf_it);
+      } else {
+        connection->CopyFrom(*lf_it);
+      }
+      mf_it++;
+      lf_it++;
+    } else {
+      lf_it++;
+    }
+  }
+
+  genome.mutable_lstm_units()->CopyFrom(more_fit.lstm_units());
+}
+
+// Children of crossover() and of the reference from the same random streams
+// are byte for byte identical, whichever parent is the more fit.
+void expect_reference(const Genome& more_fit, const Genome& less_fit) {
+  for (uint64_t id = 0; id < kStreams; id++) {
+    Genome expected;
+    Genome actual;
+    {
+      utils::random::ScopedStream stream{0, id};
+      reference_crossover(more_fit, less_fit, &expected);
+    }
+    {
+      utils::random::ScopedStream stream{0, id};
+      reproduction::crossover(more_fit, less_fit, &actual);
+    }
+    EXPECT(expected.SerializeAsString() == actual.SerializeAsString(),
+           "%d connections: mismatch on stream %lu",
+           more_fit.connections_size(), id);
+  }
+}
+
+TEST(crossover_matches_reference) {
+  for (size_t connections : {10, 100, 1000, 10000}) {
+    bench::GenomePair pair{connections};
+    expect_reference(pair.a, pair.b);
+    expect_reference(pair.b, pair.a);
+  }
+}
+
+// A child that is cleared and reused gets the same genes as a new one.
+TEST(crossover_reused_child) {
+  bench::GenomePair pair{1000};
+  Genome child;
+  for (uint64_t id = 0; id < kStreams; id++) {
+    Genome expected;
+    {
+      utils::random::ScopedStream stream{0, id};
+      reproduction::crossover(pair.a, pair.b, &expected);
+    }
+    child.Clear();
+    {
+      utils::random::ScopedStream stream{0, id};
+      reproduction::crossover(pair.a, pair.b, &child);
+    }
+    EXPECT(expected.SerializeAsString() == child.SerializeAsString(),
+           "reused child differs on stream %lu", id);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "neat_lstm/activation.h"
+#include "neat_lstm/lstm_kernel.h"
+#include "neat_lstm/utils/random.h"
+#include "proto/structures.pb.h"
+#include "synthetic.h"
+#include "test.h"
+
+namespace {
+
+const int kInputSize = 8;
+const int kSteps = 16;
+const int kCapacities[] = {8, 16, 32, 64, 128, 256, 512};
+
+// Straightforward implementation of an LSTM timestep, one gate at a time
+class ReferenceLSTM {
+ public:
+  ReferenceLSTM(const LSTMUnit& lstm_unit)
+      : lstm_unit_(lstm_unit),
+        state_(lstm_unit.capacity(), 0),
+        activations_(lstm_unit.capacity(), 0) {}
+
+  void step(const std::vector<double>& inputs) {
+    std::vector<double> variables = activations_;
+    variables.insert(variables.end(), inputs.begin(), inputs.end());
+
+    auto i_t = gate(lstm_unit_.input_weights(), variables,
+                    lstm_unit_.input_bias(), activation::sigmoid);
+    auto f_t = gate(lstm_unit_.forget_weights(), variables,
+                    lstm_unit_.forget_bias(), activation::sigmoid);
+    auto c_t = gate(lstm_unit_.state_weights(), variables,
+                    lstm_unit_.state_bias(), activation::tanh);
+    auto o_t = gate(lstm_unit_.output_weights(), variables,
+                    lstm_unit_.output_bias(), activation::sigmoid);
+    for (size_t i = 0; i < state_.size(); i++) {
+      state_.at(i) = f_t.at(i) * state_.at(i) + i_t.at(i) * c_t.at(i);
+      activations_.at(i) = o_t.at(i) * activation::tanh(state_.at(i));
+    }
+  }
+
+  const std::vector<double>& activations() const { return activations_; }
+
+ private:
+  const LSTMUnit& lstm_unit_;
+  std::vector<double> state_;
+  std::vector<double> activations_;
+
+  std::vector<double> gate(
+      const google::protobuf::RepeatedField<double>& weights,
+      const std::vector<double>& variables, double bias,
+      activation_t<double>* squash) {
+    std::vector<double> output(state_.size(), 0);
+    for (size_t i = 0; i < output.size(); i++) {
+      for (size_t j = 0; j < variables.size(); j++) {
+        output.at(i) += weights.Get(i * variables.size() + j) * variables.at(j);
+      }
+      output.at(i) = squash(output.at(i) + bias);
+    }
+    return output;
+  }
+};
+
+std::vector<double> random_inputs() {
+  std::vector<double> inputs(kInputSize);
+  for (auto& input : inputs) {
+    input = utils::random::uniform(-1, 1);
+  }
+  return inputs;
+}
+
+// Steps the kernel and the reference with the same inputs, expecting their
+// activations to stay within tolerance.
+template <typename Scalar>
+void expect_reference(LSTMKernel<Scalar>& kernel, const LSTMUnit& lstm_unit,
+                      double tolerance) {
+  ReferenceLSTM reference{lstm_unit};
+  for (int t = 0; t < kSteps; t++) {
+    auto inputs = random_inputs();
+    std::copy(inputs.begin(), inputs.end(), kernel.inputs());
+    kernel.step();
+    reference.step(inputs);
+    double error = 0;
+    for (int i = 0; i < lstm_unit.capacity(); i++) {
+      error = std::max(error, std::abs(kernel.activations()[i] -
+                                       reference.activations().at(i)));
+    }
+    EXPECT(error <= tolerance,
+           "capacity %d, step %d: error %g above tolerance %g",
+           lstm_unit.capacity(), t, error, tolerance);
+  }
+}
+
+template <typename Scalar>
+void expect_reference(activation::Mode mode, double tolerance) {
+  for (int capacity : kCapacities) {
+    LSTMUnit lstm_unit = bench::synthetic_lstm_unit(capacity, kInputSize);
+    LSTMKernel<Scalar> kernel{lstm_unit, kInputSize, mode};
+    expect_reference(kernel, lstm_unit, tolerance);
+  }
+}
+
+TEST(lstm_kernel_exact_double) {
+  expect_reference<double>(activation::Mode::kExact, 1e-9);
+}
+
+// Single precision, to rounding error of float
+TEST(lstm_kernel_exact_float) {
+  expect_reference<float>(activation::Mode::kExact, 1e-5);
+}
+
+// Fast activations, to their approximation error
+TEST(lstm_kernel_fast_double) {
+  expect_reference<double>(activation::Mode::kFast, 1e-5);
+}
+
+TEST(lstm_kernel_fast_float) {
+  expect_reference<float>(activation::Mode::kFast, 2e-5);
+}
+
+// A kernel rebuilt for units of other capacities, larger and smaller than
+// its buffers, behaves as a new one.
+TEST(lstm_kernel_rebuild) {
+  LSTMUnit first = bench::synthetic_lstm_unit(64, kInputSize);
+  LSTMKernel<double> kernel{first, kInputSize};
+  for (int capacity : {16, 512, 8, 64}) {
+    auto inputs = random_inputs();
+    std::copy(inputs.begin(), inputs.end(), kernel.inputs());
+    kernel.step();
+    LSTMUnit lstm_unit = bench::synthetic_lstm_unit(capacity, kInputSize);
+    kernel.rebuild(lstm_unit, kInputSize);
+    EXPECT(kernel.capacity() == capacity, "capacity %d after rebuild to %d",
+           kernel.capacity(), capacity);
+    expect_reference(kernel, lstm_unit, 1e-9);
+  }
+}
+
+}  // namespace
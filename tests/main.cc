@@ -0,0 +1,81 @@
+#include <google/protobuf/text_format.h>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "default_config.h"
+#include "neat_lstm/config_store.h"
+#include "proto/config.pb.h"
+#include "test.h"
+
+namespace test {
+namespace {
+
+struct Test {
+  std::string name;
+  test_t* test;
+};
+
+std::vector<Test>& registry() {
+  static std::vector<Test> tests;
+  return tests;
+}
+
+// Failures of the running test
+int failures = 0;
+
+}  // namespace
+
+bool register_test(const char* name, test_t* test) {
+  registry().push_back({name, test});
+  return true;
+}
+
+void fail(const char* file, int line, const char* format, ...) {
+  std::fprintf(stderr, "%s:%d: ", file, line);
+  va_list args;
+  va_start(args, format);
+  std::vfprintf(stderr, format, args);
+  va_end(args);
+  std::fprintf(stderr, "\n");
+  failures++;
+}
+
+}  // namespace test
+
+// Runs all registered tests, or those whose names contain the filter, with
+// res/default.config. Fails if any test does, or if none match the filter.
+// ./neat_lstm_test [filter]
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!google::protobuf::TextFormat::ParseFromString(bench::kDefaultConfig,
+                                                     &config)) {
+    std::fprintf(stderr, "Cannot parse res/default.config\n");
+    return 1;
+  }
+  ConfigStore::get().set(config);
+
+  const char* filter = argc > 1 ? argv[1] : "";
+  int run = 0;
+  int failed = 0;
+  for (const auto& test : test::registry()) {
+    if (test.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    test::failures = 0;
+    test.test();
+    run++;
+    if (test::failures > 0) {
+      failed++;
+    }
+    std::printf("%-8s %s\n", test::failures > 0 ? "FAILED" : "OK",
+                test.name.c_str());
+  }
+
+  if (run == 0) {
+    std::fprintf(stderr, "No tests match '%s'\n", filter);
+    return 1;
+  }
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#ifndef NEAT_LSTM_TESTS_TEST_H
+#define NEAT_LSTM_TESTS_TEST_H
+
+// A minimal, self-contained test harness.
+// Tests are functions registered with TEST, which report failed expectations
+// with EXPECT and keep running. ./neat_lstm_test runs the tests whose names
+// contain a filter, and fails if any of them did.
+namespace test {
+
+typedef void test_t();
+
+bool register_test(const char* name, test_t* test);
+
+// Fails the running test, printing the location and a printf-style message.
+void fail(const char* file, int line, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+}  // namespace test
+
+#define TEST(name)                        \
+  static void name();                     \
+  static const bool name##_registered_ =  \
+      ::test::register_test(#name, name); \
+  static void name()
+
+#define EXPECT(condition, ...)                       \
+  do {                                               \
+    if (!(condition)) {                              \
+      ::test::fail(__FILE__, __LINE__, __VA_ARGS__); \
+    }                                                \
+  } while (0)
+
+#endif
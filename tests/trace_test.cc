@@ -0,0 +1,72 @@
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "neat_lstm/trace.h"
+#include "test.h"
+
+namespace {
+
+const int kThreads = 4;
+const int kRestarts = 200;
+
+std::string temporary_file() {
+  char path[] = "/tmp/neat_lstm_trace_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  return path;
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream input(path);
+  std::stringstream buffer;
+  buffer << input.rdbuf();
+  return buffer.str();
+}
+
+// Tracing restarts with other capacities and writes while threads record,
+// with spans open across the restarts.
+TEST(trace_restart_while_recording) {
+  const std::string path = temporary_file();
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&done] {
+      while (!done.load()) {
+        trace::ScopedSpan outer{"outer"};
+        for (int k = 0; k < 64; k++) {
+          trace::ScopedSpan inner{"inner", k};
+        }
+      }
+    });
+  }
+  for (int i = 0; i < kRestarts; i++) {
+    trace::start(i % 2 == 0 ? 16 : 1024);
+    EXPECT(trace::write(path), "cannot write %s", path.c_str());
+    trace::stop();
+  }
+  done.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Threads that did not record since the last start() contribute no spans
+  trace::start(16);
+  { trace::ScopedSpan span{"last"}; }
+  trace::stop();
+  EXPECT(trace::write(path), "cannot write %s", path.c_str());
+  const std::string json = read_file(path);
+  EXPECT(json.find("\"last\"") != std::string::npos, "missing last span");
+  EXPECT(json.find("\"inner\"") == std::string::npos,
+         "spans from before start()");
+  std::remove(path.c_str());
+}
+
+}  // namespace